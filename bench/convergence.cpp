@@ -0,0 +1,388 @@
+// 收敛速度回归测试：按递增的每像素样本数（或时间预算）渲染 scenes.h 中的场景，与高样本数的参考图比较，
+// 按积分器和采样器的每种组合输出 RMSE、relMSE、效率和达到目标误差所需的时间。
+// 用法：rt_convergence [--scenes 5,7] [--width 128] [--spp 4,16,64 | --seconds 0.5,1,2] [--reference-spp 1024] [--fresh-reference]
+//       [--integrators recursive,batched,wavefront] [--samplers independent,halton,sobol,blue_noise]
+//       [--target 0.01] [--json 文件|-] [--baseline 文件] [--threshold 0.2]
+// 误差都按线性颜色计算；relMSE = mean((x-ref)^2 / (ref^2 + 0.01))。无偏估计的 relMSE 与耗时成反比，
+// 所以效率取 1 / (relMSE * 秒)，不随样本数变化，直接比较不同配置和不同构建。
+// 参考图用独立随机采样、逐条递归追踪渲染（与被测的低差异序列不相关），缓存在 ../output/reference_<场景>_<宽度>_<样本数>.pfm。
+// 给出 --baseline（之前 --json 写出的结果）时，任何配置的效率比基准低 threshold 以上就以返回值1退出
+
+#include "../src/scenes.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <sstream>
+#include <streambuf>
+
+static const char* scene_names[] = {
+    "final_scene_small", "bouncing_spheres", "checkered_spheres", "earth", "perlin_spheres", "quads", "simple_light",
+    "cornell_box", "cornell_smoke", "final_scene", "many_lights", "smoke_plume", "sun_and_sky"
+};
+
+static const char* sampler_names[] = {"independent", "halton", "sobol", "blue_noise"};
+
+class render_config { // 一种积分器与采样器的组合
+public:
+    std::string integrator; // recursive（逐条递归）、batched（逐像素按材质分批，sort_by_material）、wavefront（波前）
+    sampler::kind sampler_type;
+
+    std::string name() const { return integrator + "/" + sampler_names[int(sampler_type)]; }
+};
+
+class capture_hook : public render_hook { // 改写场景的相机设置，取回样本均值和耗时
+public:
+    int width = 128;
+    int samples = 16;
+    render_config config;
+    unsigned seed = 1;
+
+    int image_width = 0, image_height = 0;
+    std::vector<color> image;
+    double seconds = 0;
+
+    void configure(camera& cam) override {
+        cam.image_width = width;
+        cam.samples_per_pixel = samples;
+        cam.sampler_type = config.sampler_type;
+        cam.sort_by_material = config.integrator == "batched";
+        cam.wavefront = config.integrator == "wavefront";
+        cam.packet_size = 0;
+        cam.denoise = false;
+        cam.write_aovs = false;
+        cam.cost_heatmaps = false;
+        std::srand(seed); // 场景搭建用掉的随机数之后，渲染从固定的种子开始（参考图用另一个种子，与被测渲染不相关）
+    }
+
+    void finished(const render_buffers& buffers, double s) override {
+        image_width = buffers.width;
+        image_height = buffers.height;
+        image.resize(buffers.size());
+        for (size_t k = 0; k < buffers.size(); k++) image[k] = buffers.beauty(k);
+        seconds = s;
+    }
+};
+
+class quiet_output { // 作用域内丢弃 std::cout 和 std::clog 的输出（渲染进度、场景统计）
+public:
+    quiet_output() : cout_buffer(std::cout.rdbuf(&sink)), clog_buffer(std::clog.rdbuf(&sink)) {}
+    ~quiet_output() {
+        std::cout.rdbuf(cout_buffer);
+        std::clog.rdbuf(clog_buffer);
+    }
+
+private:
+    class null_buffer : public std::streambuf {
+        int overflow(int c) override { return c; }
+    } sink;
+    std::streambuf* cout_buffer;
+    std::streambuf* clog_buffer;
+};
+
+static void render(int scene, capture_hook& hook) {
+    std::srand(1); // 随机放置物体的场景每次搭建得都一样
+    active_render_hook() = &hook;
+    {
+        quiet_output quiet;
+        render_scene(scene);
+    }
+    active_render_hook() = nullptr;
+}
+
+static bool read_pfm(const std::string& filename, int& w, int& h, std::vector<color>& image) { // 三通道 PFM（小端，从最下面一行开始）
+    std::ifstream in(filename, std::ios::binary);
+    std::string magic;
+    double scale;
+    if (!(in >> magic >> w >> h >> scale) || magic != "PF" || scale >= 0 || w <= 0 || h <= 0) return false;
+    in.get();
+    std::vector<float> row(size_t(w) * 3);
+    image.assign(size_t(w) * h, color(0,0,0));
+    for (int j = h - 1; j >= 0; j--) {
+        if (!in.read(reinterpret_cast<char*>(row.data()), sizeof(float) * row.size())) return false;
+        for (int i = 0; i < w; i++)
+            image[size_t(j) * w + i] = color(row[3 * i], row[3 * i + 1], row[3 * i + 2]);
+    }
+    return true;
+}
+
+static void write_pfm(const std::string& filename, int w, int h, const std::vector<color>& image) {
+    std::ofstream out(filename, std::ios::binary);
+    out << "PF\n" << w << ' ' << h << "\n-1\n";
+    std::vector<float> row(size_t(w) * 3);
+    for (int j = h - 1; j >= 0; j--) {
+        for (int i = 0; i < w; i++)
+            for (int c = 0; c < 3; c++) row[3 * i + c] = float(image[size_t(j) * w + i][c]);
+        out.write(reinterpret_cast<const char*>(row.data()), sizeof(float) * row.size());
+    }
+}
+
+class level_result { // 一档样本数的结果
+public:
+    int samples;
+    double seconds, rmse, relmse;
+
+    double efficiency() const { return relmse > 0 && seconds > 0 ? 1 / (relmse * seconds) : 0; }
+};
+
+static level_result compare(const capture_hook& hook, const std::vector<color>& reference) {
+    double se = 0, rel = 0;
+    for (size_t k = 0; k < reference.size(); k++)
+        for (int c = 0; c < 3; c++) {
+            auto d = hook.image[k][c] - reference[k][c];
+            se += d * d;
+            rel += d * d / (reference[k][c] * reference[k][c] + 0.01);
+        }
+    auto n = 3.0 * reference.size();
+    return {hook.samples, hook.seconds, std::sqrt(se / n), rel / n};
+}
+
+static double time_to_target(const std::vector<level_result>& levels, double target, bool& extrapolated) {
+    // relMSE 随时间按幂律下降：在越过目标的两档之间按对数坐标插值；
+    // 第一档已经达到或最后一档仍未达到时，按 relMSE 与时间成反比从那一档外推
+    extrapolated = true;
+    if (levels.empty()) return 0;
+    if (levels.front().relmse <= target) return levels.front().seconds * levels.front().relmse / target;
+    for (size_t k = 1; k < levels.size(); k++) {
+        const auto& a = levels[k - 1];
+        const auto& b = levels[k];
+        if (b.relmse > target) continue;
+        extrapolated = false;
+        auto slope = std::log(b.relmse / a.relmse) / std::log(b.seconds / a.seconds);
+        if (!(slope < 0)) return b.seconds;
+        return a.seconds * std::pow(target / a.relmse, 1 / slope);
+    }
+    return levels.back().seconds * levels.back().relmse / target;
+}
+
+class config_result { // 一个场景上一种配置的汇总
+public:
+    std::string name;           // 场景/积分器/采样器
+    double efficiency;          // 样本数最多的一档的效率
+    double relmse, seconds;     // 同一档的误差和耗时
+    double target_seconds;      // 达到目标 relMSE 的时间
+    bool extrapolated;
+};
+
+static std::vector<int> parse_ints(const char* list) {
+    std::vector<int> v;
+    std::stringstream in(list);
+    for (std::string item; std::getline(in, item, ',');)
+        if (!item.empty()) v.push_back(std::atoi(item.c_str())); // 跳过空项（"4,,16" 或单独的 ","）
+    return v;
+}
+
+static std::vector<double> parse_doubles(const char* list) {
+    std::vector<double> v;
+    std::stringstream in(list);
+    for (std::string item; std::getline(in, item, ',');)
+        if (!item.empty()) v.push_back(std::atof(item.c_str())); // 跳过空项（"4,,16" 或单独的 ","）
+    return v;
+}
+
+static std::vector<std::string> parse_names(const char* list) {
+    std::vector<std::string> v;
+    std::stringstream in(list);
+    for (std::string item; std::getline(in, item, ',');) v.push_back(item);
+    return v;
+}
+
+static std::map<std::string, double> load_baseline(std::istream& in) { // 读入 --json 写出的结果：名字 -> 效率（每项占一行）
+    std::map<std::string, double> baseline;
+    std::string line;
+    const std::string name_key = "\"name\": \"", efficiency_key = "\"efficiency\": ";
+    while (std::getline(in, line)) {
+        auto n = line.find(name_key), e = line.find(efficiency_key);
+        if (n == std::string::npos || e == std::string::npos) continue;
+        n += name_key.size();
+        baseline[line.substr(n, line.find('"', n) - n)] = std::atof(line.c_str() + e + efficiency_key.size());
+    }
+    return baseline;
+}
+
+static void write_json(std::ostream& out, const std::vector<config_result>& results, int width, int reference_spp, double target) {
+    out << "{\n  \"width\": " << width << ",\n  \"reference_spp\": " << reference_spp << ",\n  \"target_relmse\": " << target
+        << ",\n  \"results\": [\n";
+    for (size_t k = 0; k < results.size(); k++) {
+        const auto& r = results[k];
+        out << "    {\"name\": \"" << r.name << "\", \"efficiency\": " << r.efficiency << ", \"relmse\": " << r.relmse
+            << ", \"seconds\": " << r.seconds << ", \"time_to_target\": " << r.target_seconds
+            << ", \"extrapolated\": " << (r.extrapolated ? "true" : "false") << "}" << (k + 1 < results.size() ? "," : "") << '\n';
+    }
+    out << "  ]\n}\n";
+}
+
+int main(int argc, char** argv) {
+    std::vector<int> scenes = {5, 7};
+    std::vector<int> spp = {4, 16, 64};
+    std::vector<double> budgets;        // 时间预算（秒），给出时代替 spp
+    bool timed = false;                 // 给出了 --seconds
+    int width = 128;
+    int reference_spp = 1024;
+    bool fresh_reference = false;
+    std::vector<std::string> integrators = {"recursive", "batched", "wavefront"};
+    std::vector<std::string> samplers = {"independent", "halton", "sobol", "blue_noise"};
+    double target = 0.01;
+    double threshold = 0.2;
+    std::string json;
+    std::map<std::string, double> baseline;
+
+    for (int k = 1; k < argc; k++) {
+        auto arg = argv[k];
+        auto value = k + 1 < argc ? argv[k + 1] : nullptr;
+        if (!std::strcmp(arg, "--scenes") && value) { scenes = parse_ints(value); k++; }
+        else if (!std::strcmp(arg, "--spp") && value) { spp = parse_ints(value); k++; }
+        else if (!std::strcmp(arg, "--seconds") && value) { budgets = parse_doubles(value); timed = true; k++; }
+        else if (!std::strcmp(arg, "--width") && value) { width = std::atoi(value); k++; }
+        else if (!std::strcmp(arg, "--reference-spp") && value) { reference_spp = std::atoi(value); k++; }
+        else if (!std::strcmp(arg, "--fresh-reference")) fresh_reference = true;
+        else if (!std::strcmp(arg, "--integrators") && value) { integrators = parse_names(value); k++; }
+        else if (!std::strcmp(arg, "--samplers") && value) { samplers = parse_names(value); k++; }
+        else if (!std::strcmp(arg, "--target") && value) { target = std::atof(value); k++; }
+        else if (!std::strcmp(arg, "--threshold") && value) { threshold = std::atof(value); k++; }
+        else if (!std::strcmp(arg, "--json") && value) { json = value; k++; }
+        else if (!std::strcmp(arg, "--baseline") && value) {
+            std::ifstream in(value);
+            baseline = load_baseline(in);
+            if (baseline.empty()) {
+                std::cerr << "ERROR: Could not read convergence results from '" << value << "'.\n";
+                return 1;
+            }
+            k++;
+        }
+        else {
+            std::cerr << "Usage: " << argv[0] << " [--scenes 5,7] [--width N] [--spp 4,16,64 | --seconds 0.5,1,2] [--reference-spp N]"
+                      << " [--fresh-reference] [--integrators recursive,batched,wavefront] [--samplers independent,halton,sobol,blue_noise]"
+                      << " [--target relmse] [--json file|-] [--baseline file] [--threshold fraction]\n";
+            return 1;
+        }
+    }
+
+    // 样本数（或时间预算）至少一个且都为正，场景编号必须在 scene_names 范围内（0 为低分辨率的最终场景）
+    auto positive = [](const auto& v) { return !v.empty() && std::all_of(v.begin(), v.end(), [](auto x) { return x > 0; }); };
+    if (timed ? !positive(budgets) : !positive(spp)) {
+        std::cerr << "ERROR: " << (timed ? "--seconds" : "--spp") << " needs a list of positive values.\n";
+        return 1;
+    }
+    if (width <= 0 || reference_spp <= 0) {
+        std::cerr << "ERROR: --width and --reference-spp must be positive.\n";
+        return 1;
+    }
+    const int scene_count = int(sizeof scene_names / sizeof scene_names[0]);
+    if (scenes.empty()) {
+        std::cerr << "ERROR: --scenes needs at least one scene number.\n";
+        return 1;
+    }
+    for (int scene : scenes)
+        if (scene < 0 || scene >= scene_count) {
+            std::cerr << "ERROR: Unknown scene " << scene << " (scenes are numbered 0-" << scene_count - 1 << ").\n";
+            return 1;
+        }
+
+    std::vector<render_config> configs;
+    for (const auto& integrator : integrators)
+        for (const auto& s : samplers) {
+            int kind = int(std::find_if(std::begin(sampler_names), std::end(sampler_names),
+                                        [&](const char* n) { return s == n; }) - std::begin(sampler_names));
+            if (kind >= 4 || (integrator != "recursive" && integrator != "batched" && integrator != "wavefront")) {
+                std::cerr << "ERROR: Unknown configuration '" << integrator << '/' << s << "'.\n";
+                return 1;
+            }
+            configs.push_back({integrator, sampler::kind(kind)});
+        }
+
+    auto& log = json == "-" ? std::cerr : std::cout; // 标准输出只留给 JSON
+    log << std::setprecision(4);
+    std::vector<config_result> results;
+    bool regressed = false;
+
+    for (int scene : scenes) {
+        std::string scene_name = scene_names[scene];
+        capture_hook hook;
+        hook.width = width;
+
+        // 参考图：有缓存时直接读取
+        std::vector<color> reference;
+        int ref_w = 0, ref_h = 0;
+        auto ref_file = "..//output//reference_" + scene_name + "_" + std::to_string(width) + "_" + std::to_string(reference_spp) + ".pfm";
+        if (fresh_reference || !read_pfm(ref_file, ref_w, ref_h, reference)) {
+            log << scene_name << ": rendering reference (" << reference_spp << " spp)..." << std::flush;
+            hook.samples = reference_spp;
+            hook.config = {"recursive", sampler::kind::independent};
+            hook.seed = 12345;
+            render(scene, hook);
+            reference = hook.image;
+            ref_w = hook.image_width;
+            ref_h = hook.image_height;
+            write_pfm(ref_file, ref_w, ref_h, reference);
+            log << ' ' << hook.seconds << " s\n";
+        }
+        hook.seed = 1;
+
+        log << "\n" << scene_name << " (" << ref_w << 'x' << ref_h << ", reference " << reference_spp << " spp)\n"
+            << "  " << std::left << std::setw(24) << "config" << std::right << std::setw(6) << "spp" << std::setw(11) << "seconds"
+            << std::setw(12) << "RMSE" << std::setw(12) << "relMSE" << std::setw(12) << "efficiency" << '\n';
+
+        for (const auto& config : configs) {
+            hook.config = config;
+            auto levels = spp;
+            if (!budgets.empty()) { // 按4个样本的耗时把时间预算换算成样本数
+                hook.samples = 4;
+                render(scene, hook);
+                levels.clear();
+                for (auto b : budgets)
+                    levels.push_back(std::max(1, int(b * 4 / std::max(hook.seconds, 1e-6) + 0.5)));
+            }
+
+            std::vector<level_result> measured;
+            for (int samples : levels) {
+                hook.samples = samples;
+                render(scene, hook);
+                if (hook.image.size() != reference.size()) {
+                    std::cerr << "ERROR: Reference " << ref_file << " does not match the image size (use --fresh-reference).\n";
+                    return 1;
+                }
+                auto r = compare(hook, reference);
+                measured.push_back(r);
+                log << "  " << std::left << std::setw(24) << config.name() << std::right << std::setw(6) << r.samples
+                    << std::setw(11) << r.seconds << std::setw(12) << r.rmse << std::setw(12) << r.relmse
+                    << std::setw(12) << r.efficiency() << '\n';
+            }
+
+            config_result result;
+            result.name = scene_name + "/" + config.name();
+            result.efficiency = measured.back().efficiency();
+            result.relmse = measured.back().relmse;
+            result.seconds = measured.back().seconds;
+            result.target_seconds = time_to_target(measured, target, result.extrapolated);
+            results.push_back(result);
+
+            log << "  " << std::left << std::setw(24) << "" << std::right << " time to relMSE " << target << ": "
+                << result.target_seconds << " s" << (result.extrapolated ? " (extrapolated)" : "");
+            auto base = baseline.find(result.name);
+            if (base != baseline.end() && base->second > 0) {
+                auto ratio = result.efficiency / base->second;
+                log << ", efficiency " << ratio << "x baseline";
+                if (ratio < 1 - threshold) {
+                    log << "  REGRESSION";
+                    regressed = true;
+                }
+            }
+            log << '\n';
+        }
+    }
+
+    if (json == "-") write_json(std::cout, results, width, reference_spp, target);
+    else if (!json.empty()) {
+        std::ofstream out(json);
+        write_json(out, results, width, reference_spp, target);
+    }
+
+    if (regressed) {
+        log << "\nEfficiency regressed by more than " << threshold * 100 << "% against the baseline.\n";
+        return 1;
+    }
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__)
+#define RTW_HAVE_TSC 1
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#endif
+
+template <typename T>
+inline void do_not_optimize(const T& value) { // 让编译器认为 value 被使用了，被测代码不会被当作死代码删掉
+#if defined(__GNUC__)
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    static volatile const T* sink;
+    sink = &value;
+#endif
+}
+
+class microbench {
+    // 微基准测试：每项先按 min_round_seconds 确定每轮的调用次数，预热 warmup_rounds 轮，再计时 repeats 轮，
+    // 报告每次调用耗时的中位数、最小值、均值和标准差，以及每秒操作数和每次调用的周期数（x86 上是 TSC 计数，即额定频率下的周期）
+public:
+    int warmup_rounds = 2;              // 预热轮数（不计入结果）
+    int repeats = 15;                   // 计时轮数
+    double min_round_seconds = 0.01;    // 每轮至少运行的时间
+    std::string filter;                 // 只运行名字包含该字符串的项（为空时全部运行）
+    std::ostream* log = &std::cout;     // 逐项输出结果的位置
+
+    class result { // 一项的结果（耗时都是每次调用的纳秒数）
+    public:
+        std::string name;
+        size_t calls_per_round = 0;
+        double ns_median = 0, ns_min = 0, ns_mean = 0, ns_stddev = 0;
+        double cycles = 0;              // 每次调用的周期数（中位数，无 TSC 时为0）
+
+        double ops_per_second() const { return ns_median > 0 ? 1e9 / ns_median : 0; }
+    };
+
+    bool selected(const std::string& name) const { return filter.empty() || name.find(filter) != std::string::npos; }
+
+    template <typename F>
+    void run(const std::string& name, F op) { // op(i) 执行一次被测操作，i 是调用序号（用来轮换输入）
+        if (!selected(name)) return;
+
+        op(0); // 第一次调用可能带有一次性的初始化（如生成查找表），不参与确定调用次数
+        size_t calls = 1;
+        for (;;) { // 调用次数按倍增确定，使一轮的耗时不小于 min_round_seconds
+            auto s = round(op, calls);
+            if (s.seconds >= min_round_seconds || calls >= (size_t(1) << 32)) break;
+            calls = s.seconds > 0 ? std::max(calls * 2, size_t(calls * 1.2 * min_round_seconds / s.seconds)) : calls * 16;
+        }
+        for (int w = 0; w < warmup_rounds; w++) round(op, calls);
+
+        std::vector<double> ns, cycles;
+        for (int k = 0; k < std::max(1, repeats); k++) {
+            auto s = round(op, calls);
+            ns.push_back(s.seconds * 1e9 / calls);
+            cycles.push_back(double(s.ticks) / calls);
+        }
+
+        result r;
+        r.name = name;
+        r.calls_per_round = calls;
+        r.ns_median = median(ns);
+        r.ns_min = *std::min_element(ns.begin(), ns.end());
+        for (auto v : ns) r.ns_mean += v / ns.size();
+        for (auto v : ns) r.ns_stddev += (v - r.ns_mean) * (v - r.ns_mean) / ns.size();
+        r.ns_stddev = std::sqrt(r.ns_stddev);
+        r.cycles = median(cycles);
+        results.push_back(r);
+
+        *log << "  " << name << std::string(name.size() < 34 ? 34 - name.size() : 1, ' ')
+             << r.ns_median << " ns/op  (min " << r.ns_min << ", sd " << r.ns_stddev << ")  "
+             << r.ops_per_second() * 1e-6 << " Mops/s  " << r.cycles << " cycles";
+        auto base = baseline.find(name);
+        if (base != baseline.end() && base->second > 0)
+            *log << "  " << r.ns_median / base->second << "x baseline";
+        *log << '\n';
+    }
+
+    bool load_baseline(std::istream& in) { // 读入之前用 write_json 写出的结果，之后每项同时输出与它的耗时比
+        std::string line;
+        const std::string name_key = "\"name\": \"", ns_key = "\"ns_per_op\": ";
+        while (std::getline(in, line)) { // write_json 每项占一行
+            auto n = line.find(name_key), t = line.find(ns_key);
+            if (n == std::string::npos || t == std::string::npos) continue;
+            n += name_key.size();
+            baseline[line.substr(n, line.find('"', n) - n)] = std::atof(line.c_str() + t + ns_key.size());
+        }
+        return !baseline.empty();
+    }
+
+    void write_json(std::ostream& out, const std::string& build) const { // build：构建的说明（编译器、开关），对比不同构建时区分来源
+        out << "{\n  \"build\": \"" << build << "\",\n  \"repeats\": " << repeats
+            << ",\n  \"min_round_seconds\": " << min_round_seconds << ",\n  \"results\": [\n";
+        for (size_t k = 0; k < results.size(); k++) {
+            const auto& r = results[k];
+            out << "    {\"name\": \"" << r.name << "\", \"ns_per_op\": " << r.ns_median << ", \"ns_min\": " << r.ns_min
+                << ", \"ns_mean\": " << r.ns_mean << ", \"ns_stddev\": " << r.ns_stddev
+                << ", \"ops_per_sec\": " << r.ops_per_second() << ", \"cycles_per_op\": " << r.cycles
+                << ", \"calls_per_round\": " << r.calls_per_round << "}" << (k + 1 < results.size() ? "," : "") << '\n';
+        }
+        out << "  ]\n}\n";
+    }
+
+private:
+    std::vector<result> results;
+    std::map<std::string, double> baseline; // 对比基准：名字 -> 每次调用的纳秒数
+
+    struct round_time { double seconds; uint64_t ticks; };
+
+    template <typename F>
+    static round_time round(F& op, size_t calls) {
+        auto start = std::chrono::steady_clock::now();
+        auto t0 = ticks();
+        for (size_t i = 0; i < calls; i++) op(i);
+        auto t1 = ticks();
+        auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return {seconds, t1 - t0};
+    }
+
+    static uint64_t ticks() {
+#if RTW_HAVE_TSC
+        return __rdtsc();
+#else
+        return 0;
+#endif
+    }
+
+    static double median(std::vector<double> v) {
+        std::sort(v.begin(), v.end());
+        auto n = v.size();
+        return n % 2 ? v[n / 2] : 0.5 * (v[n / 2 - 1] + v[n / 2]);
+    }
+};
\ No newline at end of file
@@ -0,0 +1,282 @@
+// 求交、纹理、材质和随机数内核的微基准测试。
+// 用法：rt_microbench [--filter 名字片段] [--repeats N] [--warmup N] [--min-time 秒] [--json 文件|-] [--compare 文件]
+// 每项的输入都预先生成好，计时循环里只有被测调用本身。--json 写出结果，另一个构建（RTW_SIMD、RTW_FAST_MATH、编译选项）
+// 运行时用 --compare 读入，逐项输出耗时之比
+// 计时之前先检查复用的交点记录在 spread 为0时足迹清零（选第0层 MIP），以及镜面反射之后足迹继续累积，检查失败时返回1
+
+#include "rtweekend.h"
+
+#include "arena.h"
+#include "BVH.h"
+#include "hittable_list.h"
+#include "material.h"
+#include "Perlin.h"
+#include "Quad.h"
+#include "sampler.h"
+#include "sphere.h"
+#include "Texture.h"
+
+#include "microbench.h"
+
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+static const int input_count = 1024; // 每项轮换使用的输入个数（2的幂）
+
+static std::vector<ray> random_rays(const point3& target, double spread) { // 从半径10的球面上射向 target 附近（偏离不超过 spread）的射线
+    std::vector<ray> rays;
+    for (int k = 0; k < input_count; k++) {
+        auto origin = 10 * random_unit_vector();
+        auto aim = target + spread * random_in_unit_sphere();
+        rays.emplace_back(origin, aim - origin, random_double());
+    }
+    return rays;
+}
+
+static bool check_footprints(std::ostream& log) {
+    // 计时之前的正确性检查：交点记录会被复用（波前的 hits、分批路径的 rec），spread 为0的射线命中后
+    // 像素足迹必须清零，否则沿用上一次的足迹，纹理查询会选到错误的 MIP 层级
+    sphere ball(point3(0, 0, -2), 1, nullptr);
+    quad square(point3(-1, -1, -2), vec3(2, 0, 0), vec3(0, 2, 0), nullptr);
+    mipmap earth;
+    if (!rtw_image::locate("earthmap.jpg").empty()) earth = mipmap("earthmap.jpg");
+
+    bool ok = true;
+    auto check = [&](const char* name, const hittable& object) {
+        hit_record rec;
+        for (double spread : {0.01, 0.0}) {
+            ray r(point3(0.1, 0.2, 5), vec3(0, 0, -1), 0.0, spread);
+            if (!object.hit(r, interval(0.001, infinity), rec)) { ok = false; continue; }
+            object.finalize_hit(r, rec);
+        }
+        if (rec.du != 0 || rec.dv != 0 || (!earth.empty() && earth.level_of_detail(rec.du, rec.dv) != 0)) {
+            log << "CHECK FAILED: " << name << " keeps a stale pixel footprint (du=" << rec.du << ", dv=" << rec.dv << ") for a spread-0 ray\n";
+            ok = false;
+        }
+    };
+    check("sphere::finalize_hit", ball);
+    check("quad::finalize_hit", square);
+
+    // 镜子里看到的纹理：相机到镜面3、镜面到纹理四边形3，足迹应与直接在距离6处看到的相同，
+    // 比直接在距离3处看到的宽（MIP 层级更粗），而不是在镜面处从0重新开始
+    metal mirror_material(color(1, 1, 1), 0.0);
+    quad mirror(point3(-1, -1, 2), vec3(2, 0, 0), vec3(0, 2, 0), &mirror_material);
+    quad textured(point3(-1, -1, 5), vec3(2, 0, 0), vec3(0, 2, 0), nullptr);
+    auto footprint = [&](ray r, bool via_mirror, hit_record& rec) { // 沿 r 看 textured（via_mirror 时先经过 mirror 反射）
+        if (via_mirror) {
+            scatter_record srec;
+            if (!mirror.hit(r, interval(0.001, infinity), rec)) return false;
+            mirror.finalize_hit(r, rec);
+            if (!mirror_material.scatter(r, rec, srec)) return false;
+            r = srec.scattered;
+        }
+        if (!textured.hit(r, interval(0.001, infinity), rec)) return false;
+        textured.finalize_hit(r, rec);
+        return true;
+    };
+    hit_record direct, reflected;
+    if (!footprint(ray(point3(0.1, 0.2, 8), vec3(0, 0, -1), 0.0, 0.01), false, direct)
+        || !footprint(ray(point3(0.1, 0.2, 5), vec3(0, 0, -1), 0.0, 0.01), true, reflected)
+        || !(reflected.du > direct.du && reflected.dv > direct.dv)
+        || (!earth.empty() && !(earth.level_of_detail(reflected.du, reflected.dv) > earth.level_of_detail(direct.du, direct.dv)))) {
+        log << "CHECK FAILED: metal::scatter restarts the pixel footprint at the mirror (du=" << reflected.du
+            << " behind the mirror, " << direct.du << " seen directly at the same distance)\n";
+        ok = false;
+    }
+    return ok;
+}
+
+static void bench_primitives(microbench& bench) {
+    auto rays = random_rays(point3(0, 0, 0), 1.5); // 半径1的物体大约一半命中
+
+    aabb box(point3(-1, -1, -1), point3(1, 1, 1));
+    bench.run("aabb::hit", [&](size_t i) {
+        do_not_optimize(box.hit(rays[i & (input_count - 1)], interval(0.001, infinity)));
+    });
+
+    sphere still(point3(0, 0, 0), 1, nullptr);
+    sphere moving(point3(0, -0.5, 0), point3(0, 0.5, 0), 1, nullptr);
+    quad square(point3(-1, -1, 0), vec3(2, 0, 0), vec3(0, 2, 0), nullptr);
+
+    auto run_hit = [&](const std::string& name, const hittable& object) {
+        hit_record rec;
+        bench.run(name, [&](size_t i) {
+            do_not_optimize(object.hit(rays[i & (input_count - 1)], interval(0.001, infinity), rec));
+        });
+        bench.run(name + "+finalize_hit", [&](size_t i) { // 命中后补全着色数据（uv 中有 atan2/acos）
+            const auto& r = rays[i & (input_count - 1)];
+            if (object.hit(r, interval(0.001, infinity), rec)) object.finalize_hit(r, rec);
+            do_not_optimize(rec);
+        });
+    };
+    run_hit("sphere::hit (static)", still);
+    run_hit("sphere::hit (moving)", moving);
+    run_hit("quad::hit", square);
+}
+
+static void bench_bvh(microbench& bench) {
+    // 合成场景：边长 20 的立方体内随机放置 n 个小球，球的半径随 n 减小，使场景的遮挡程度大致不变
+    for (int n : {16, 256, 4096, 65536}) {
+        auto name = "bvh_node::hit (" + std::to_string(n) + " spheres)";
+        if (!bench.selected(name)) continue;
+
+        scene_arena arena;
+        material_table materials(&arena);
+        auto mat = materials.add<lambertian>(color(0.5, 0.5, 0.5));
+        hittable_list list;
+        auto radius = 4.0 / std::cbrt(double(n));
+        for (int k = 0; k < n; k++)
+            list.add(arena.make<sphere>(point3(random_double(-10, 10), random_double(-10, 10), random_double(-10, 10)), radius, mat));
+        bvh_node bvh(list, &arena);
+
+        std::vector<ray> rays;
+        for (int k = 0; k < input_count; k++)
+            rays.emplace_back(point3(random_double(-10, 10), random_double(-10, 10), -30), vec3(random_double(-0.3, 0.3), random_double(-0.3, 0.3), 1));
+
+        hit_record rec;
+        bench.run(name, [&](size_t i) {
+            do_not_optimize(bvh.hit(rays[i & (input_count - 1)], interval(0.001, infinity), rec));
+        });
+    }
+}
+
+static void bench_textures(microbench& bench) {
+    std::vector<point3> points;
+    for (int k = 0; k < input_count; k++) points.push_back(vec3::random(-4, 4));
+
+    perlin noise;
+    bench.run("perlin::turb (depth 7)", [&](size_t i) {
+        do_not_optimize(noise.turb(points[i & (input_count - 1)], 7));
+    });
+
+    if (!bench.selected("image_texture::value")) return;
+    if (rtw_image::locate("earthmap.jpg").empty()) {
+        *bench.log << "  image_texture::value skipped: earthmap.jpg not found (set RTW_IMAGES)\n";
+        return;
+    }
+    image_texture earth("earthmap.jpg");
+    std::vector<double> us, vs;
+    for (int k = 0; k < input_count; k++) {
+        us.push_back(random_double());
+        vs.push_back(random_double());
+    }
+    bench.run("image_texture::value (bilinear)", [&](size_t i) {
+        auto k = i & (input_count - 1);
+        do_not_optimize(earth.value(us[k], vs[k], point3(), 0, 0));
+    });
+    bench.run("image_texture::value (trilinear)", [&](size_t i) { // 足迹约4个纹素，走 MIP 层级之间的插值
+        auto k = i & (input_count - 1);
+        do_not_optimize(earth.value(us[k], vs[k], point3(), 0.002, 0.002));
+    });
+}
+
+static void bench_materials(microbench& bench) {
+    // 交点取自单位球：射线从外侧射入，补全法线、uv 和材质后交给 scatter()
+    sphere ball(point3(0, 0, 0), 1, nullptr);
+    auto rays = random_rays(point3(0, 0, 0), 0.5);
+    std::vector<hit_record> recs;
+    for (const auto& r : rays) {
+        hit_record rec;
+        if (!ball.hit(r, interval(0.001, infinity), rec)) continue;
+        ball.finalize_hit(r, rec);
+        recs.push_back(rec);
+    }
+    auto count = recs.size();
+
+    material_table materials;
+    std::pair<const char*, const material*> list[] = {
+        {"lambertian", materials.add<lambertian>(color(0.5, 0.5, 0.5))},
+        {"metal", materials.add<metal>(color(0.8, 0.8, 0.8), 0.3)},
+        {"dielectric", materials.add<dielectric>(1.5)},
+        {"diffuse_light", materials.add<diffuse_light>(color(4, 4, 4))},
+        {"isotropic", materials.add<isotropic>(color(0.7, 0.7, 0.7))},
+    };
+    for (const auto& m : list) {
+        scatter_record srec;
+        bench.run(std::string("material::scatter (") + m.first + ")", [&](size_t i) {
+            auto k = i % count;
+            do_not_optimize(m.second->scatter(rays[k], recs[k], srec));
+            do_not_optimize(srec);
+        });
+    }
+}
+
+static void bench_random(microbench& bench) {
+    bench.run("random_double", [&](size_t) { do_not_optimize(random_double()); });
+    bench.run("random_unit_vector", [&](size_t) { do_not_optimize(random_unit_vector()); });
+    bench.run("random_in_unit_sphere", [&](size_t) { do_not_optimize(random_in_unit_sphere()); });
+
+    for (auto type : {sampler::kind::sobol, sampler::kind::halton, sampler::kind::blue_noise}) {
+        static const char* names[] = {"independent", "halton", "sobol", "blue_noise"};
+        sampler s(type, 64);
+        bench.run(std::string("sampler::next (") + names[int(type)] + ")", [&](size_t i) {
+            if (i % 16 == 0) s.start_pixel_sample(int(i >> 10) & 63, int(i >> 16) & 63, int(i >> 4) & 63); // 每个样本取16维（相机加一次反弹）
+            do_not_optimize(s.next());
+        });
+    }
+}
+
+static std::string build_description() { // 编译器与影响内核的开关
+    std::ostringstream out;
+#if defined(__clang__)
+    out << "clang " << __clang_major__ << '.' << __clang_minor__;
+#elif defined(__GNUC__)
+    out << "gcc " << __GNUC__ << '.' << __GNUC_MINOR__;
+#elif defined(_MSC_VER)
+    out << "msvc " << _MSC_VER;
+#endif
+#if defined(__AVX512F__)
+    out << " avx512";
+#elif defined(__AVX2__)
+    out << " avx2";
+#elif defined(__AVX__)
+    out << " avx";
+#endif
+    out << " RTW_SIMD=" << RTW_SIMD << " RTW_FAST_MATH=" << RTW_FAST_MATH << " RTW_USE_ARENA=" << RTW_USE_ARENA;
+    return out.str();
+}
+
+int main(int argc, char** argv) {
+    microbench bench;
+    std::string json;
+    for (int k = 1; k < argc; k++) {
+        auto arg = argv[k];
+        auto value = k + 1 < argc ? argv[k + 1] : nullptr;
+        if (!std::strcmp(arg, "--filter") && value) { bench.filter = value; k++; }
+        else if (!std::strcmp(arg, "--repeats") && value) { bench.repeats = std::atoi(value); k++; }
+        else if (!std::strcmp(arg, "--warmup") && value) { bench.warmup_rounds = std::atoi(value); k++; }
+        else if (!std::strcmp(arg, "--min-time") && value) { bench.min_round_seconds = std::atof(value); k++; }
+        else if (!std::strcmp(arg, "--json") && value) { json = value; k++; }
+        else if (!std::strcmp(arg, "--compare") && value) {
+            std::ifstream in(value);
+            if (!bench.load_baseline(in)) {
+                std::cerr << "ERROR: Could not read benchmark results from '" << value << "'.\n";
+                return 1;
+            }
+            k++;
+        }
+        else {
+            std::cerr << "Usage: " << argv[0] << " [--filter name] [--repeats N] [--warmup N] [--min-time seconds] [--json file|-] [--compare file]\n";
+            return 1;
+        }
+    }
+
+    if (json == "-") bench.log = &std::cerr; // 标准输出只留给 JSON
+
+    auto build = build_description();
+    *bench.log << "rt_microbench: " << build << ", " << bench.repeats << " repeats\n";
+    if (!check_footprints(std::cerr)) return 1;
+    bench_primitives(bench);
+    bench_bvh(bench);
+    bench_textures(bench);
+    bench_materials(bench);
+    bench_random(bench);
+
+    if (json == "-") bench.write_json(std::cout, build);
+    else if (!json.empty()) {
+        std::ofstream out(json);
+        bench.write_json(out, build);
+    }
+    return 0;
+}
\ No newline at end of file
@@ -3,20 +3,25 @@
 #include "rtweekend.h"
 
 #include "AABB.h"
+#include "arena.h"
 #include "hittable.h"
 #include "hittable_list.h"
+#include "trace.h"
 
 #include <algorithm>
 
 class bvh_node : public hittable {
 public:
-    bvh_node(hittable_list list)
-        : bvh_node(list.objects, 0, list.objects.size())
+    bvh_node(hittable_list list, scene_arena* arena = nullptr)
+        : bvh_node(list.objects, 0, list.objects.size(), arena)
     {
         // 这里有一个 C++ 的微妙之处。这个构造函数（没有 span 索引）会创建一个隐式的可点击列表副本，我们将对其进行修改。复制列表的生命周期只持续到该构造函数退出为止。因为我们只需要持久化所生成的BVH。
     }
 
-    bvh_node(std::vector<shared_ptr<hittable>>& objects, size_t start, size_t end) { // 构造BVH树的结点，参数为物体列表，起始索引，结束索引
+    // 构造BVH树的结点，参数为物体列表，起始索引，结束索引；给定 arena 时子结点按深度优先顺序在内存池中连续分配
+    bvh_node(std::vector<shared_ptr<hittable>>& objects, size_t start, size_t end, scene_arena* arena = nullptr) {
+        RTW_TRACE_ZONE_ARG("build", end - start >= trace_min_span ? "bvh_node build" : nullptr, "objects", end - start);
+
         // 构建源对象跨度的包围盒
         bbox = aabb::empty; // 初始化包围盒为空
         for (size_t object_index=start; object_index < end; object_index++) // 遍历所有物体,更新包围盒
@@ -36,16 +41,20 @@ public:
             left = objects[start];  // 左子树是第一个物体
             right = objects[start+1];   // 右子树是第二个物体
         } else {    // 如果有多个物体
-            std::sort(objects.begin() + start, objects.begin() + end, comparator);  // 对物体（按照包围盒的最左边的位置）进行排序
+            {
+                RTW_TRACE_ZONE_ARG("build", object_span >= trace_min_span ? "bvh sort" : nullptr, "objects", object_span);
+                std::sort(objects.begin() + start, objects.begin() + end, comparator);  // 对物体（按照包围盒的最左边的位置）进行排序
+            }
 
             // 递归构建左右子树
             auto mid = start + object_span/2;   // 中间位置
-            left = make_shared<bvh_node>(objects, start, mid);  // 递归构建左子树
-            right = make_shared<bvh_node>(objects, mid, end);   // 递归构建右子树
+            left = make_node(objects, start, mid, arena);   // 递归构建左子树
+            right = make_node(objects, mid, end, arena);    // 递归构建右子树
         }
     }
 
     bool hit(const ray& r, interval ray_t, hit_record& rec) const override { // 判断射线是否与BVH树相交
+        count_cost(&cost_counters::bvh_nodes);
         if (!bbox.hit(r, ray_t))    // 如果射线与包围盒不相交，直接返回false
             return false;
 
@@ -55,12 +64,35 @@ public:
         return hit_left || hit_right; // 返回左右子树是否有一个相交
     }
 
+    void hit_packet(ray_packet& packet, uint32_t active, double t_min) const override {
+        // 整包遍历：只保留可能与包围盒相交的射线；活动射线少于 min_packet 条时包已经发散，改为逐条遍历子树
+        active = packet.cull(bbox, active, t_min);
+        if (!active) return;
+
+        if (ray_packet::count(active) < min_packet) {
+            packet.hit(*this, active, t_min);
+            return;
+        }
+
+        left->hit_packet(packet, active, t_min);
+        right->hit_packet(packet, active, t_min);
+    }
+
     aabb bounding_box() const override { return bbox; } // 返回包围盒
 
+    bool has_motion() const override { return left->has_motion() || (right != left && right->has_motion()); }
+
 private:
     shared_ptr<hittable> left; // 左子树
     shared_ptr<hittable> right;// 右子树
     aabb bbox; // 包围盒
+    static const int min_packet = 3; // 整包遍历的最少活动射线数
+    static const size_t trace_min_span = 256; // 时间线只记录物体数不少于此的结点的构建（见 trace.h）
+
+    static shared_ptr<hittable> make_node(std::vector<shared_ptr<hittable>>& objects, size_t start, size_t end, scene_arena* arena) {
+        if (arena) return arena->make<bvh_node>(objects, start, end, arena);
+        return make_shared<bvh_node>(objects, start, end);
+    }
 
     static bool box_compare(const shared_ptr<hittable> a, const shared_ptr<hittable> b, int axis_index) { // 比较两个物体在某个坐标轴上的包围盒
         auto a_axis_interval = a->bounding_box().axis_interval(axis_index); // 获取a的包围盒在axis_index轴上的区间
@@ -24,27 +24,43 @@ public:
     }
 
     double noise(const point3& p) const {
-        // 取出p的x、y和z坐标的小数部分，用作线性插值
-        auto u = p.x() - floor(p.x());
-        auto v = p.y() - floor(p.y());
-        auto w = p.z() - floor(p.z());
-
-        // 计算出三个索引i、j和k。这些索引是通过将点p的x、y和z坐标分别向下取整，然后转换为整数并与255进行位与操作得到的。位与操作的目的是将结果限制在0到255的范围内。
-        auto i = int(floor(p.x()));
-        auto j = int(floor(p.y()));
-        auto k = int(floor(p.z()));
-        vec3 c[2][2][2];  // 存储噪声值的数组
-
-        for (int di=0; di < 2; di++)
-            for (int dj=0; dj < 2; dj++)
-                for (int dk=0; dk < 2; dk++)
-                    c[di][dj][dk] = randvec[
-                        perm_x[(i+di) & 255] ^
-                        perm_y[(j+dj) & 255] ^
-                        perm_z[(k+dk) & 255]
-                    ]; // 从randvec数组中取出一个随机向量作为噪声值。
-
-        return perlin_interp(c, u, v, w); // 返回线性插值的结果
+        // 取出p的x、y和z坐标的小数部分，用作插值
+        auto fx = floor(p.x());
+        auto fy = floor(p.y());
+        auto fz = floor(p.z());
+        auto u = p.x() - fx;
+        auto v = p.y() - fy;
+        auto w = p.z() - fz;
+
+        // 格点索引与255做位与，限制在0到255的范围内。三个排列表各只查两次（原来每个角点各查一次，共24次）
+        auto i = int(fx) & 255;
+        auto j = int(fy) & 255;
+        auto k = int(fz) & 255;
+        int x0 = perm_x[i], x1 = perm_x[(i+1) & 255];
+        int y0 = perm_y[j], y1 = perm_y[(j+1) & 255];
+        int z0 = perm_z[k], z1 = perm_z[(k+1) & 255];
+
+        // 8个角点的随机向量与（角点到p的）权重向量的点乘
+        auto n000 = corner(x0^y0^z0, u,   v,   w);
+        auto n001 = corner(x0^y0^z1, u,   v,   w-1);
+        auto n010 = corner(x0^y1^z0, u,   v-1, w);
+        auto n011 = corner(x0^y1^z1, u,   v-1, w-1);
+        auto n100 = corner(x1^y0^z0, u-1, v,   w);
+        auto n101 = corner(x1^y0^z1, u-1, v,   w-1);
+        auto n110 = corner(x1^y1^z0, u-1, v-1, w);
+        auto n111 = corner(x1^y1^z1, u-1, v-1, w-1);
+
+        // 三个方向上的Hermite插值，写成嵌套的lerp（7次乘法，原来的三重循环为8x4次）
+        auto uu = u*u*(3-2*u);
+        auto vv = v*v*(3-2*v);
+        auto ww = w*w*(3-2*w);
+        auto n00 = n000 + ww*(n001 - n000);
+        auto n01 = n010 + ww*(n011 - n010);
+        auto n10 = n100 + ww*(n101 - n100);
+        auto n11 = n110 + ww*(n111 - n110);
+        auto n0 = n00 + vv*(n01 - n00);
+        auto n1 = n10 + vv*(n11 - n10);
+        return n0 + uu*(n1 - n0); // [-1,1]
     }
 
     double turb(const point3& p, int depth) const { // 扰动函数
@@ -86,23 +102,8 @@ private:
         }
     }
 
-    static double perlin_interp(const vec3 c[2][2][2], double u, double v, double w) {
-        // 计算三个方向上的Hermite插值
-        auto uu = u*u*(3-2*u);
-        auto vv = v*v*(3-2*v);
-        auto ww = w*w*(3-2*w);
-        auto accum = 0.0;
-
-        for (int i=0; i < 2; i++)
-            for (int j=0; j < 2; j++)
-                for (int k=0; k < 2; k++) {
-                    vec3 weight_v(u-i, v-j, w-k);   // 权重向量
-                    accum += (i*uu + (1-i)*(1-uu))
-                           * (j*vv + (1-j)*(1-vv))
-                           * (k*ww + (1-k)*(1-ww))
-                           * dot(c[i][j][k], weight_v); // 点乘
-                }
-
-        return accum; // [-1,1]
+    double corner(int hash, double a, double b, double c) const { // 角点随机向量与权重向量(a,b,c)的点乘
+        const auto& g = randvec[hash];
+        return g.e[0]*a + g.e[1]*b + g.e[2]*c;
     }
 };
\ No newline at end of file
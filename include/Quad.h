@@ -2,18 +2,21 @@
 
 #include "rtweekend.h"
 
+#include "arena.h"
 #include "hittable.h"
 #include "hittable_list.h"
+#include "material.h"
 
 class quad : public hittable {
 public:
-    quad(const point3& Q, const vec3& u, const vec3& v, shared_ptr<material> mat)
+    quad(const point3& Q, const vec3& u, const vec3& v, const material* mat)
     : Q(Q), u(u), v(v), mat(mat)    // 初始化，设置四边形的顶点Q，两个边向量u和v，以及材质
     {
         auto n = cross(u, v);   // 计算法向量
         normal = unit_vector(n); // normal是单位法向量
         D = dot(normal, Q); // Ax+By+Cz=D, D = -n·Q, n是法向量, Q是四边形起始点
         w = n / dot(n,n); // 存储法向量的倒数，用于加速计算
+        area = n.length(); // 面积
 
         set_bounding_box(); // 设置包围盒
     }
@@ -28,6 +31,7 @@ public:
     aabb bounding_box() const override { return bbox; }
 
     bool hit(const ray& r, interval ray_t, hit_record& rec) const override {
+        count_cost(&cost_counters::primitive_tests);
         auto denom = dot(normal, r.direction()); // 计算射线方向与单位法向量的点积,考虑到normal是单位向量，所以这里计算的是射线方向与法向量的夹角的cos值，
 
         if (fabs(denom) < 1e-8) // 如果射线与四边形平行（即平面法向量与射线方向垂直），没有交点
@@ -47,15 +51,53 @@ public:
         if (!is_interior(alpha, beta, rec))
             return false;
 
-        // 射线击中 2D 形状；设置交点记录的其余部分并返回 true。
+        // 射线击中 2D 形状；只记录t和图元，(α,β)已由is_interior写入rec.u、rec.v
         rec.t = t;
-        rec.p = intersection;
+        rec.prim = this;
+        rec.inside = nullptr; // 普通表面，外层的 constant_medium 会改写为自己的介质
+
+        return true;
+    }
+
+    void finalize_hit(const ray& r, hit_record& rec) const override { // 为最近交点补全着色数据
+        rec.p = r.at(rec.t);
         rec.mat = mat;
         rec.set_face_normal(r, normal);
 
+        // 像素足迹：(α,β)在u、v边上各自从0变到1。spread 为0时也要写（足迹为0），rec 可能是上一次命中复用下来的
+        auto footprint = r.footprint(rec.t);
+        rec.du = footprint / u.length();
+        rec.dv = footprint / v.length();
+    }
+
+    double pdf_value(const point3& origin, const vec3& direction) const override {
+        // 面积上的均匀采样换算到立体角：pdf = 距离^2 / (|cosθ| * 面积)
+        hit_record rec;
+        if (!this->hit(ray(origin, direction), interval(0.001, infinity), rec))
+            return 0;
+
+        auto distance_squared = rec.t * rec.t * direction.length_squared();
+        auto cosine = fabs(dot(direction, normal) / direction.length());
+
+        return distance_squared / (cosine * area);
+    }
+
+    double emitted_power() const override { // 漫反射面光源的功率 = π * 辐射亮度 * 面积（diffuse_light两面发光）
+        if (!mat) return 0.0;
+        auto radiance = luminance(mat->emitted(0.5, 0.5, Q + 0.5*(u + v)));
+        return radiance > 0 ? pi * radiance * 2*area : 0.0;
+    }
+
+    bool emission_normal(vec3& n) const override {
+        n = normal;
         return true;
     }
 
+    vec3 random(const point3& origin) const override { // 在四边形上均匀取一点
+        auto p = Q + (random_double() * u) + (random_double() * v);
+        return p - origin;
+    }
+
     virtual bool is_interior(double a, double b, hit_record& rec) const {
         interval unit_interval = interval(0, 1); // (α,β)的单位区间
         // 根据平面坐标给出命中点，如果命中点位于基元之外，则返回 false，否则设置命中记录 UV 坐标并返回 true。
@@ -73,16 +115,20 @@ private:
     point3 Q;   // 四边形的起始点(假设为左下角)
     vec3 u, v;  // Q的两个边向量
     vec3 w;  // 法向量的倒数，用于加速计算
-    shared_ptr<material> mat; // 材质
+    const material* mat; // 材质
     aabb bbox;  // 包围盒
     vec3 normal;  // 法向量
     double D; // Ax+By+Cz=D, D = -n·Q, n是法向量, Q是四边形起始点
+    double area; // 面积（光源采样用）
 };
 
-inline shared_ptr<hittable_list> box(const point3& a, const point3& b, shared_ptr<material> mat) {
-    // 返回一个3D盒子，由两个对角顶点a和b定义，材质为mat
+inline shared_ptr<hittable_list> box(const point3& a, const point3& b, const material* mat, scene_arena* arena = nullptr) {
+    // 返回一个3D盒子，由两个对角顶点a和b定义，材质为mat；给定 arena 时六个面在内存池中连续分配
+    auto make_side = [arena](const point3& Q, const vec3& u, const vec3& v, const material* mat) {
+        return arena ? arena->make<quad>(Q, u, v, mat) : make_shared<quad>(Q, u, v, mat);
+    };
 
-    auto sides = make_shared<hittable_list>();
+    auto sides = arena ? arena->make<hittable_list>() : make_shared<hittable_list>();
 
     // 用最小和最大坐标构造两个相对的顶点。
     auto min = point3(fmin(a.x(), b.x()), fmin(a.y(), b.y()), fmin(a.z(), b.z()));
@@ -92,12 +138,12 @@ inline shared_ptr<hittable_list> box(const point3& a, const point3& b, shared_pt
     auto dy = vec3(0, max.y() - min.y(), 0);
     auto dz = vec3(0, 0, max.z() - min.z());
 
-    sides->add(make_shared<quad>(point3(min.x(), min.y(), max.z()),  dx,  dy, mat)); // front
-    sides->add(make_shared<quad>(point3(max.x(), min.y(), max.z()), -dz,  dy, mat)); // right
-    sides->add(make_shared<quad>(point3(max.x(), min.y(), min.z()), -dx,  dy, mat)); // back
-    sides->add(make_shared<quad>(point3(min.x(), min.y(), min.z()),  dz,  dy, mat)); // left
-    sides->add(make_shared<quad>(point3(min.x(), max.y(), max.z()),  dx, -dz, mat)); // top
-    sides->add(make_shared<quad>(point3(min.x(), min.y(), min.z()),  dx,  dz, mat)); // bottom
+    sides->add(make_side(point3(min.x(), min.y(), max.z()),  dx,  dy, mat)); // front
+    sides->add(make_side(point3(max.x(), min.y(), max.z()), -dz,  dy, mat)); // right
+    sides->add(make_side(point3(max.x(), min.y(), min.z()), -dx,  dy, mat)); // back
+    sides->add(make_side(point3(min.x(), min.y(), min.z()),  dz,  dy, mat)); // left
+    sides->add(make_side(point3(min.x(), max.y(), max.z()),  dx, -dz, mat)); // top
+    sides->add(make_side(point3(min.x(), min.y(), min.z()),  dx,  dz, mat)); // bottom
 
     return sides;
 }
\ No newline at end of file
@@ -2,24 +2,37 @@
 
 #include "rtweekend.h"
 
+#include "AABB.h"
+
+#include "mipmap.h"
 #include "perlin.h"
 #include "rtw_stb_image.h"
 
-class Texture { // 纹理
+class Texture { // 纹理。纹理的种类是封闭的：基类保存类型标记，value()用switch分派到具体纹理，不经过虚函数表
 public:
-    virtual ~Texture() = default;
+    enum class kind : unsigned char { solid, checker, image, noise }; // 纹理类型
+
+    kind type() const { return tag; }
+
+    // 根据纹理坐标返回纹理颜色；du、dv为像素足迹在纹理坐标上的宽度，供需要过滤的纹理选择MIP层级
+    color value(double u, double v, const point3& p, double du, double dv) const; // 定义在所有纹理类之后
 
-    virtual color value(double u, double v, const point3& p) const = 0; // 根据纹理坐标返回纹理颜色
+protected:
+    explicit Texture(kind tag) : tag(tag) {}
+    ~Texture() = default; // 非虚析构：纹理总是经 make_shared/arena.make 创建，shared_ptr 按具体类型析构
+
+private:
+    kind tag; // 纹理类型
 };
 
 class solid_color : public Texture { // 恒定的颜色纹理
 public:
-    solid_color(const color& albedo) : albedo(albedo) {}
+    solid_color(const color& albedo) : Texture(kind::solid), albedo(albedo) {}
 
     solid_color(double red, double green, double blue)
         :solid_color(color(red,green,blue)) {}
 
-    color value(double u, double v, const point3& p) const override {
+    color value(double u, double v, const point3& p, double du, double dv) const {
         return albedo;
     }
 
@@ -27,18 +40,35 @@ private:
     color albedo; //Albedo 参数控制着表面的基色
 };
 
+class texture_ref { // 材质和棋盘纹理引用纹理的方式：恒定颜色直接内联保存（求值时不做任何分派），其他纹理保存指针
+public:
+    texture_ref(const color& albedo) : constant(albedo) {}
+
+    texture_ref(shared_ptr<Texture> t) { // 传入的是恒定颜色纹理时折叠成内联颜色
+        if (t->type() == Texture::kind::solid)
+            constant = static_cast<const solid_color*>(t.get())->value(0, 0, point3(), 0, 0);
+        else
+            tex = std::move(t);
+    }
+
+    color value(double u, double v, const point3& p, double du, double dv) const {
+        return tex ? tex->value(u, v, p, du, dv) : constant;
+    }
+
+private:
+    shared_ptr<Texture> tex; // 非恒定纹理（为空表示恒定颜色）
+    color constant;          // 恒定颜色
+};
+
 class checker_texture : public Texture { // 棋盘纹理
 public:
     checker_texture(double scale, shared_ptr<Texture> even, shared_ptr<Texture> odd)    // 棋盘纹理的缩放比例，偶数纹理，奇数纹理
-        : inv_scale(1.0 / scale), even(even), odd(odd) {}
+        : Texture(kind::checker), inv_scale(1.0 / scale), even(even), odd(odd) {}
 
     checker_texture(double scale, const color& c1, const color& c2) // 棋盘纹理的缩放比例，偶数纹理颜色，奇数纹理颜色
-        : inv_scale(1.0 / scale),
-        even(make_shared<solid_color>(c1)),
-        odd(make_shared<solid_color>(c2))
-    {}
+        : Texture(kind::checker), inv_scale(1.0 / scale), even(c1), odd(c2) {}
 
-    color value(double u, double v, const point3& p) const override { // 根据纹理坐标返回纹理颜色
+    color value(double u, double v, const point3& p, double du, double dv) const { // 根据纹理坐标返回纹理颜色
         // 纹理坐标映射到棋盘纹理上
         auto xInteger = int(std::floor(inv_scale * p.x()));
         auto yInteger = int(std::floor(inv_scale * p.y()));
@@ -46,51 +76,116 @@ public:
 
         bool isEven = (xInteger + yInteger + zInteger) % 2 == 0; // 判断是否是偶数纹理
 
-        return isEven ? even->value(u, v, p) : odd->value(u, v, p); // 返回偶数纹理或奇数纹理的颜色
+        return isEven ? even.value(u, v, p, du, dv) : odd.value(u, v, p, du, dv); // 返回偶数纹理或奇数纹理的颜色
     }
 
 private:
     double inv_scale; // 棋盘纹理的缩放比例
-    shared_ptr<Texture> even;   // 偶数纹理
-    shared_ptr<Texture> odd;    // 奇数纹理
+    texture_ref even;   // 偶数纹理
+    texture_ref odd;    // 奇数纹理
 };
 
 class image_texture : public Texture { // 图像纹理
 public:
-    image_texture(const char* filename) : image(filename) {} // 从文件名加载图像
+    image_texture(const char* filename) : Texture(kind::image), mip(filename) {} // 打开图像对应的分块MIP金字塔（首次使用时从图像转换生成）
 
-    color value(double u, double v, const point3& p) const override {
+    color value(double u, double v, const point3& p, double du, double dv) const {
         // 如果没有纹理数据，则返回纯青色作为调试辅助
-        if (image.height() <= 0) return color(0,1,1);
+        if (mip.empty()) return color(0,1,1);
 
         // 将输入的纹理坐标限制在[0,1] x [1,0]之间
         u = interval(0,1).clamp(u);
         v = 1.0 - interval(0,1).clamp(v);  // 将 V 翻转到图像坐标
 
-        // 纹理坐标映射到图像上
-        auto i = int(u * image.width());
-        auto j = int(v * image.height());
-        auto pixel = image.pixel_data(i,j); // 获取(i,j)处像素数据
-
-        // 将像素数据转换为颜色(原来的像素数据是[0,255]范围内的整数值，转换层[0,1]范围内的浮点数值)
-        auto color_scale = 1.0 / 255.0;
-        return color(color_scale*pixel[0], color_scale*pixel[1], color_scale*pixel[2]);
+        // 按像素足迹做三线性过滤（足迹为0时为第0层的双线性插值）
+        return mip.lookup(u, v, du, dv);
     }
 private:
-    rtw_image image; // 图像
+    mipmap mip; // 分块存储的MIP金字塔（纹素块经 texture_cache 按需读入）
 };
 
 class noise_texture : public Texture { // 噪声纹理
 public:
-    noise_texture() {}
-
-    noise_texture(double scale = 1) : scale(scale) {}
+    noise_texture() : Texture(kind::noise) {}
+
+    noise_texture(double scale = 1) : Texture(kind::noise), scale(scale) {}
+
+    void bake(const aabb& bounds, int resolution, int octaves = 7) {
+        // 可选的烘焙模式：把 bounds 内的扰动值预先计算到 resolution^3 的网格上，查询时做三线性插值，
+        // bounds 之外仍按程序化方式求值。分辨率和八度数决定精度与速度（及内存：resolution^3 个float）的取舍。
+        // 参数无效时报错并保持未烘焙（全部程序化求值）
+        grid.clear();
+        if (resolution < 2) {
+            std::cerr << "ERROR: noise_texture::bake needs a resolution of at least 2 (got " << resolution << ").\n";
+            return;
+        }
+        auto padded = aabb(bounds.x, bounds.y, bounds.z); // 平面区域（如四边形的包围盒）某个轴宽度为0时填充到最小宽度，否则网格坐标除以0
+        for (int a = 0; a < 3; a++) {
+            auto size = padded.axis_interval(a).size();
+            if (!(size > 0 && std::isfinite(size))) {
+                std::cerr << "ERROR: noise_texture::bake needs a finite, non-empty region.\n";
+                return;
+            }
+        }
+
+        region = padded;
+        grid_res = resolution;
+        grid.resize(size_t(grid_res) * grid_res * grid_res);
+
+        for (int z = 0; z < grid_res; z++)
+            for (int y = 0; y < grid_res; y++)
+                for (int x = 0; x < grid_res; x++) {
+                    auto p = point3(region.x.min + region.x.size() * x / (grid_res - 1),
+                                    region.y.min + region.y.size() * y / (grid_res - 1),
+                                    region.z.min + region.z.size() * z / (grid_res - 1));
+                    grid[(size_t(z) * grid_res + y) * grid_res + x] = float(noise.turb(p, octaves));
+                }
+    }
 
-    color value(double u, double v, const point3& p) const override {
+    color value(double u, double v, const point3& p, double du, double dv) const {
         // 返回噪声纹理的颜色
-        return color(0.5, 0.5, 0.5) * (1 + sin(scale * p.z() + 10 * noise.turb(p, 7))); // 进行扰动，同时调整频率
+        return color(0.5, 0.5, 0.5) * (1 + rtw_sin(scale * p.z() + 10 * turbulence(p))); // 进行扰动，同时调整频率
     }
 private:
     perlin noise; // 柏林噪声
     double scale; // 噪声纹理的缩放比例
-};
\ No newline at end of file
+    aabb region;  // 烘焙区域
+    int grid_res = 0; // 烘焙网格每个轴上的采样数
+    std::vector<float> grid; // 烘焙的扰动值（x最快变化），为空表示未烘焙
+
+    double turbulence(const point3& p) const { // 扰动值：在烘焙区域内查网格，否则程序化求值
+        if (grid.empty() || !region.x.contains(p.x()) || !region.y.contains(p.y()) || !region.z.contains(p.z()))
+            return noise.turb(p, 7);
+
+        // 网格坐标及所在单元
+        double g[3];
+        int i[3];
+        for (int a = 0; a < 3; a++) {
+            const auto& ax = region.axis_interval(a);
+            g[a] = (p[a] - ax.min) / ax.size() * (grid_res - 1);
+            i[a] = std::min(int(g[a]), grid_res - 2);
+            g[a] -= i[a];
+        }
+
+        auto at = [&](int dx, int dy, int dz) {
+            return double(grid[(size_t(i[2] + dz) * grid_res + i[1] + dy) * grid_res + i[0] + dx]);
+        };
+        auto c00 = at(0,0,0) + g[0]*(at(1,0,0) - at(0,0,0));
+        auto c10 = at(0,1,0) + g[0]*(at(1,1,0) - at(0,1,0));
+        auto c01 = at(0,0,1) + g[0]*(at(1,0,1) - at(0,0,1));
+        auto c11 = at(0,1,1) + g[0]*(at(1,1,1) - at(0,1,1));
+        auto c0 = c00 + g[1]*(c10 - c00);
+        auto c1 = c01 + g[1]*(c11 - c01);
+        return c0 + g[2]*(c1 - c0);
+    }
+};
+
+inline color Texture::value(double u, double v, const point3& p, double du, double dv) const { // 按类型标记分派
+    switch (tag) {
+        case kind::solid:   return static_cast<const solid_color*>(this)->value(u, v, p, du, dv);
+        case kind::checker: return static_cast<const checker_texture*>(this)->value(u, v, p, du, dv);
+        case kind::image:   return static_cast<const image_texture*>(this)->value(u, v, p, du, dv);
+        case kind::noise:   return static_cast<const noise_texture*>(this)->value(u, v, p, du, dv);
+    }
+    return color(0, 0, 0);
+}
\ No newline at end of file
@@ -0,0 +1,107 @@
+#pragma once
+
+#include "rtweekend.h"
+
+#include <cassert>
+#include <cstddef>
+#include <new>
+
+// 为 0 时 scene_arena::make 退回 make_shared，便于和原来的 shared_ptr 路径对比分配次数与缓存命中率
+#ifndef RTW_USE_ARENA
+#define RTW_USE_ARENA 1
+#endif
+
+class scene_arena { // 场景内存池（bump 分配器）：图元、BVH结点、材质和纹理连续存放，场景销毁时一次性释放
+public:
+    explicit scene_arena(size_t block_size = 1 << 20) : block_size(block_size) {}
+
+    scene_arena(const scene_arena&) = delete;
+    scene_arena& operator=(const scene_arena&) = delete;
+
+    ~scene_arena() { // 一次性释放所有内存块
+        // make() 返回的 shared_ptr 不能比内存池活得更久：对象所在的内存随内存池一起释放，之后再访问就是悬空指针
+        assert(live_objects == 0 && "scene_arena destroyed while objects made by it are still referenced");
+        for (auto block : blocks)
+            ::operator delete(block, std::align_val_t(block_alignment));
+    }
+
+    void* allocate(size_t bytes, size_t align) { // 在当前块中按对齐要求顺序分配，放不下时开新块
+        auto aligned = (offset + align - 1) & ~(align - 1);
+        if (blocks.empty() || aligned + bytes > current_size) {
+            current_size = bytes + align > block_size ? bytes + align : block_size;
+            blocks.push_back(static_cast<unsigned char*>(::operator new(current_size, std::align_val_t(block_alignment))));
+            bytes_reserved += current_size;
+            aligned = 0; // 块首地址按 block_alignment 对齐
+        }
+
+        offset = aligned + bytes;
+        bytes_requested += bytes;
+        allocations++;
+        return blocks.back() + aligned;
+    }
+
+    template <typename T, typename... Args>
+    shared_ptr<T> make(Args&&... args) {
+        // 替代 make_shared：对象和控制块一起放进内存池，析构照常进行但不归还内存。
+        // 返回的 shared_ptr（及其拷贝）必须在内存池销毁之前释放，所以场景中内存池最先声明
+#if RTW_USE_ARENA
+        return std::allocate_shared<T>(allocator<T>(this), std::forward<Args>(args)...);
+#else
+        allocations++;
+        bytes_requested += sizeof(T);
+        return make_shared<T>(std::forward<Args>(args)...);
+#endif
+    }
+
+    // 统计信息
+    size_t allocation_count() const { return allocations; }   // 分配次数（关闭内存池时为 make_shared 次数）
+    size_t live_count() const { return live_objects; }        // make() 创建、还有引用（控制块未释放）的对象数
+    size_t block_count() const { return blocks.size(); }      // 向系统申请的内存块数
+    size_t bytes_used() const { return bytes_requested; }     // 实际请求的字节数
+    size_t bytes_capacity() const { return bytes_reserved; }  // 向系统申请的字节数
+    double fragmentation() const { // 内存块中未被使用（对齐填充和块尾部浪费）的比例
+        return bytes_reserved == 0 ? 0.0 : 1.0 - double(bytes_requested) / bytes_reserved;
+    }
+
+    void report(std::ostream& out) const { // 输出内存统计
+        out << "Scene arena: " << allocations << " allocations, " << bytes_requested << " bytes";
+        if (RTW_USE_ARENA)
+            out << " in " << blocks.size() << " blocks (" << bytes_reserved << " reserved, "
+                << 100.0 * fragmentation() << "% unused)";
+        else
+            out << " via make_shared";
+        out << '\n';
+    }
+
+    template <typename T>
+    class allocator { // 供 std::allocate_shared 使用的分配器，deallocate 不归还内存，只记录对象已释放
+    public:
+        using value_type = T;
+
+        explicit allocator(scene_arena* arena) : arena(arena) {}
+        template <typename U> allocator(const allocator<U>& other) : arena(other.arena) {}
+
+        T* allocate(size_t n) {
+            arena->live_objects++;
+            return static_cast<T*>(arena->allocate(n * sizeof(T), alignof(T)));
+        }
+        void deallocate(T*, size_t) { arena->live_objects--; } // 内存随内存池一起释放
+
+        template <typename U> bool operator==(const allocator<U>& other) const { return arena == other.arena; }
+        template <typename U> bool operator!=(const allocator<U>& other) const { return arena != other.arena; }
+
+        scene_arena* arena;
+    };
+
+private:
+    static const size_t block_alignment = 64; // 内存块首地址的对齐（不小于 vec3 等 SIMD 类型要求的对齐）
+
+    size_t block_size;                    // 默认内存块大小
+    std::vector<unsigned char*> blocks;   // 已申请的内存块
+    size_t current_size = 0;              // 当前块的大小
+    size_t offset = 0;                    // 当前块中下一个空闲位置
+    size_t allocations = 0;               // 分配次数
+    size_t bytes_requested = 0;           // 请求的字节数
+    size_t bytes_reserved = 0;            // 申请的字节数
+    size_t live_objects = 0;              // 经 allocator 分配、控制块尚未释放的对象数
+};
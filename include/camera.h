@@ -5,8 +5,44 @@
 
 #include "rtweekend.h"
 
+#include "cost_heatmap.h"
+#include "denoiser.h"
+#include "environment.h"
 #include "hittable.h"
+#include "hittable_list.h"
 #include "material.h"
+#include "medium.h"
+#include "sampler.h"
+#include "trace.h"
+#include "wavefront.h"
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+
+class camera;
+
+class render_hook { // 渲染钩子：在当前线程上激活后，camera::render 开始时由它改写相机设置，结束时把结果交给它，不再降噪和写出图像（见 bench/convergence.cpp）
+public:
+    virtual void configure(camera& cam) = 0;                                    // 场景设置好相机之后、渲染之前调用
+    virtual void finished(const render_buffers& buffers, double seconds) = 0;   // seconds 为追踪所有样本所用的时间
+
+protected:
+    ~render_hook() = default;
+};
+
+inline render_hook*& active_render_hook() { // 当前线程激活的渲染钩子（为空时正常渲染）
+    static thread_local render_hook* hook = nullptr;
+    return hook;
+}
+
+template <bool ThinLens, bool MotionBlur, bool Environment>
+class render_policy { // 积分器的编译期配置：一次渲染中固定不变的设置。相机射线的生成和射线离开场景的处理按它特化，内层循环里没有这些分支
+public:
+    static constexpr bool thin_lens = ThinLens;         // 散焦：相机射线从镜头圆盘上出发（defocus_angle > 0）
+    static constexpr bool motion_blur = MotionBlur;     // 运动模糊：相机射线带随机时间（场景中有运动的物体）
+    static constexpr bool environment = Environment;    // 环境光：未命中时查询环境光（否则是常量背景色）
+};
 
 class camera {
 public:
@@ -18,6 +54,17 @@ public:
     int channels = 3; // 每个像素的通道数，对于RGB图像是3
     unsigned char* data = nullptr;  // 图像数据
     color background;               // 场景背景颜色
+    const environment_light* environment = nullptr; // 环境光，非空时代替 background；要做显式采样时把它也加入光源列表
+    bool sort_by_material = false;  // 为true时每个像素的所有样本路径逐层推进，并按材质类型分批着色（同类材质连续执行，分支保持热）
+    bool wavefront = false;         // 为true时用波前积分器：大批相机射线逐层整批求交、按材质分桶着色，阴影射线单独成队（输出各阶段耗时）
+    int packet_size = 0;            // 相机射线按 4x2(8) 或 4x4(16) 像素成包遍历BVH，0表示逐条；之后的反弹仍逐条追踪
+    bool sort_rays = false;         // 波前积分器在第一次反弹之后的每层求交前，按起点位置和方向卦限对射线重排
+    int wavefront_size = 1 << 14;   // 波前积分器每批的路径数（路径状态约占几MB，太大时各阶段之间的数据留不在缓存中）
+    sampler::kind sampler_type = sampler::kind::sobol; // 像素采样器（每个样本的相机与各次反弹维度都取自它）
+    bool denoise = false;           // 写入图像前用反照率、法线、深度引导的 à-trous 滤波降噪（低采样数预览）
+    bool write_aovs = false;        // 另外输出辅助缓冲 albedo.png、normal.png、depth.png
+    bool cost_heatmaps = false;     // 诊断：逐像素记录耗时、BVH结点访问数、图元求交数和路径段数，输出 cost_*.png 和 cost_*.pfm（后三项要用 RTW_COST_COUNTERS=1 编译；逐像素追踪，波前和射线包随之关闭）
+    atrous_denoiser denoiser;       // 降噪器参数
 
     // Camera
     double vfov = 90;                // 垂直视角（视野）
@@ -29,37 +76,74 @@ public:
     double defocus_angle = 0; // 圆锥体的角度，其顶点位于视口中心，底部（散焦盘）位于相机中心，可以用来换算焦平面的半径（即光圈大小） 
     double focus_dist = 10;   // 焦距，相机中心到完美焦平面（视口在完美焦平面上(其上的图像不会被模糊)）的距离
 
+    void render(const hittable& world, const hittable_list& lights) {
+        // 带光源列表渲染：在非镜面交点上显式采样光源（next-event estimation），并与BSDF采样用幂启发式做多重重要性采样。
+        // lights 中的图元同时也应加入 world；列表为空时等同于 render(world)。光源很多时改用 light_bvh。
+        if (lights.objects.empty()) render(world);
+        else render(world, static_cast<const hittable&>(lights));
+    }
+
+    void render(const hittable& world, const hittable& lights) { // 光源由任意实现了 pdf_value()/random() 的物体给出（如 light_bvh）
+        this->lights = &lights;
+        render(world);
+        this->lights = nullptr;
+    }
+
     void render(const hittable& world) { // 渲染图像
+        RTW_TRACE_THREAD_NAME("render");
+        if (auto hook = active_render_hook()) hook->configure(*this);
         initialize();
+        camera_media = probe_media(world); // 相机所在的介质
 
         data = new unsigned char[image_width * image_height * channels]; // 创建图像数据缓冲区
         std::cout << "Parameters\n" << image_width << ' ' << image_height << ' ' << channels << "\n255\n";
 
-        for (int j = 0; j < image_height; j++) {
-            std::clog << "\rScanlines remaining: " << (image_height - j) << ' ' << std::flush;// 输出剩余扫描线
-            for (int i = 0; i < image_width; ++i) {
-                color pixel_color(0, 0, 0); // 像素颜色初始化为黑色
-                // for (int sample = 0; sample < samples_per_pixel; ++sample) { // 对每个像素进行多次采样
-                //     ray r = get_ray(i, j); // 获取射向点(i,j)射线
-                //     pixel_color += ray_color(r, max_depth, world); // 累加颜色
-                // }
-                // int pixelIndex = (j * image_width + i) * channels; // 获取当前待写入像素索引
-
-                // 改用分层采样
-                for (int s_j = 0; s_j < sqrt_spp; s_j++) {
-                    for (int s_i = 0; s_i < sqrt_spp; s_i++) {
-                        ray r = get_ray(i, j, s_i, s_j);
-                        pixel_color += ray_color(r, max_depth, world);
-                    }
-                }
-                int pixelIndex = (j * image_width + i) * channels; // 获取当前待写入像素索引
-                write_color(pixelIndex, data, pixel_samples_scale * pixel_color); // 写入颜色（总采样的缩放）
-            }
+        std::unique_ptr<cost_heatmap> costs; // 逐像素开销（诊断）
+        if (cost_heatmaps) {
+            costs = std::make_unique<cost_heatmap>(image_width, image_height);
+            if (wavefront || packet_size > 0)
+                std::clog << "Cost heatmaps are recorded per pixel: wavefront/packet tracing is off for this render.\n";
+            if (!RTW_COST_COUNTERS)
+                std::clog << "Cost heatmaps: built without RTW_COST_COUNTERS, only the time heatmap is written.\n";
         }
+
+        render_buffers buffers(image_width, image_height); // 颜色与辅助缓冲（AOV）
+        auto start = std::chrono::steady_clock::now();
+        with_policy(world, [&](auto policy) { // 按本次渲染固定不变的设置选择特化的积分器，之后的循环里没有这些判断
+            using P = decltype(policy);
+            if (wavefront && !costs) trace_wavefront<P>(world, buffers);
+            else if (packet_size > 0 && !costs) trace_packets<P>(world, buffers);
+            else trace_pixels<P>(world, buffers, costs.get());
+        });
         std::clog << "\rDone.                 \n";// 输出完成
 
-        // 使用stbi_write_png将图像数据写入文件
-        stbi_write_png("..//output//output.png", image_width, image_height, channels, data, image_width * channels);
+        if (auto hook = active_render_hook()) {
+            hook->finished(buffers, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+            delete[] data;
+            return;
+        }
+
+        std::vector<color> pixels;
+        if (denoise) {
+            RTW_TRACE_ZONE("denoise", "denoise");
+            std::clog << "Denoising..." << std::flush;
+            pixels = denoiser.filter(buffers);
+            std::clog << "\rDenoised.   \n";
+        }
+        for (size_t k = 0; k < buffers.size(); k++) // 写入颜色（降噪结果或样本均值）
+            write_color(int(k) * channels, data, denoise ? pixels[k] : buffers.beauty(k));
+
+        if (write_aovs) write_aov_images(buffers);
+        if (costs) write_cost_images(*costs);
+
+        if (texture_cache::global().lookup_count() > 0) // 使用了图像纹理时输出纹理缓存的命中率与常驻内存
+            texture_cache::global().report(std::clog);
+
+        { // 使用stbi_write_png将图像数据写入文件
+            RTW_TRACE_ZONE("encode", "output.png");
+            stbi_write_png("..//output//output.png", image_width, image_height, channels, data, image_width * channels);
+        }
+        RTW_TRACE_WRITE("..//output//trace.json", std::clog); // 时间线（只在用 RTW_TRACE=1 编译时写出）
 
         // 清理资源
         delete[] data;
@@ -67,9 +151,7 @@ public:
 
 private:
     int    image_height;   // 以像素为单位的图像高度
-    double pixel_samples_scale; // 像素采样的缩放
-    int sqrt_spp;          // 每个像素样本数的平方根
-    double recip_sqrt_spp; // 1/sqrt_spp
+    sampler pixel_sampler; // 像素采样器
     point3 center;         // 相机中心
     point3 pixel00_loc;    // 像素(0,0)的位置
     vec3   pixel_delta_u;  // 像素沿水平方向的偏移
@@ -77,6 +159,10 @@ private:
     vec3   u, v, w;        // 相机坐标系的三个基向量(u指向右，v指向上，w指向观察点的反方向)
     vec3 defocus_disk_u;   // 焦平面上水平方向的向量
     vec3 defocus_disk_v;   // 焦平面上垂直方向的向量
+    double pixel_spread;   // 一个像素对应的光锥扩散角，用于纹理过滤
+    const hittable* lights = nullptr; // 显式采样的光源（为空时只做BSDF采样）
+    medium_stack camera_media; // 相机所在的介质（渲染开始时探测）
+    static const int max_crossings = 64; // 一段射线最多穿过的无材质介质边界数
 
     void initialize() { // 初始化
 
@@ -84,11 +170,7 @@ private:
         image_height = int(image_width / aspect_ratio); // 计算图像高度且其至少为1
         image_height = (image_height < 1) ? 1 : image_height;
 
-        // pixel_samples_scale = 1.0 / samples_per_pixel; // 计算像素采样的缩放
-
-        sqrt_spp = int(std::sqrt(samples_per_pixel));// 计算每个像素的采样次数的平方根
-        pixel_samples_scale = 1.0 / (sqrt_spp * sqrt_spp);
-        recip_sqrt_spp = 1.0 / sqrt_spp;
+        pixel_sampler = sampler(sampler_type, samples_per_pixel);
 
         center = lookfrom; // 相机中心设置
 
@@ -115,37 +197,75 @@ private:
         auto viewport_upper_left = center - (focus_dist * w) - viewport_u/2 - viewport_v/2;
         pixel00_loc = viewport_upper_left + 0.5 * (pixel_delta_u + pixel_delta_v);
 
+        // 相机光线的光锥扩散角：焦平面上一个像素的宽度除以焦距
+        pixel_spread = std::atan(pixel_delta_v.length() / focus_dist);
+
         // 计算焦平面上的基向量
         auto defocus_radius = focus_dist * tan(degrees_to_radians(defocus_angle / 2)); // 计算焦平面的半径
         defocus_disk_u = u * defocus_radius; // 焦平面上水平方向的向量
         defocus_disk_v = v * defocus_radius; // 焦平面上垂直方向的向量
     }
 
-    ray get_ray(int i, int j, int s_i, int s_j) const { // 构建一条从散焦圆盘出发并指向像素位置i，j周围随机采样点的相机光线，用于分层采样方格s_i，s_j。
-        // auto offset = sample_square();
-        auto offset = sample_square_stratified(s_i, s_j);
-        auto pixel_sample = pixel00_loc
-                          + ((i + offset.x()) * pixel_delta_u)
-                          + ((j + offset.y()) * pixel_delta_v);
+    template <typename F>
+    void with_policy(const hittable& world, F&& f) const { // 按本次渲染的设置选出 render_policy 的实例，调用 f(policy)（8种组合各实例化一次）
+        bool lens = defocus_angle > 0, motion = world.has_motion(), sky = environment != nullptr;
+        if (lens) {
+            if (motion) sky ? f(render_policy<true, true, true>()) : f(render_policy<true, true, false>());
+            else        sky ? f(render_policy<true, false, true>()) : f(render_policy<true, false, false>());
+        } else {
+            if (motion) sky ? f(render_policy<false, true, true>()) : f(render_policy<false, true, false>());
+            else        sky ? f(render_policy<false, false, true>()) : f(render_policy<false, false, false>());
+        }
+    }
 
-        auto ray_origin = (defocus_angle <= 0) ? center : defocus_disk_sample(); // 如果焦平面模糊角度为0（即焦平面半径（光圈大小）为0），则光线从相机中心发出，否则从焦平面上的随机点发出
-        auto ray_direction = pixel_sample - ray_origin; // Ray的方向为从相机中心指向像素位置(i,j)周围的随机采样点
-        auto ray_time = random_double(); // 随机生成光线的时间
+    template <typename P>
+    void trace_pixels(const hittable& world, render_buffers& buffers, cost_heatmap* costs) { // 逐像素追踪（costs 非空时记录每个像素的开销）
+        for (int j = 0; j < image_height; j++) {
+            RTW_TRACE_ZONE_ARG("render", "row", "row", j);
+            std::clog << "\rScanlines remaining: " << (image_height - j) << ' ' << std::flush;// 输出剩余扫描线
+            for (int i = 0; i < image_width; ++i) {
+                // for (int sample = 0; sample < samples_per_pixel; ++sample) { // 对每个像素进行多次采样
+                //     ray r = get_ray(i, j); // 获取射向点(i,j)射线
+                //     pixel_color += ray_color(r, max_depth, world); // 累加颜色
+                // }
+                // int pixelIndex = (j * image_width + i) * channels; // 获取当前待写入像素索引
 
-        return ray(ray_origin, ray_direction, ray_time);
+                // 改用低差异采样：每个样本的所有维度取自像素采样器；样本连同辅助缓冲一起累加到 buffers
+                cost_heatmap::pixel_scope cost(costs, i, j, samples_per_pixel);
+                if (sort_by_material)
+                    trace_pixel_batched<P>(i, j, world, buffers);
+                else
+                    for (int s = 0; s < samples_per_pixel; s++) {
+                        pixel_sampler.start_pixel_sample(i, j, s);
+                        active_sample_stream() = &pixel_sampler;
+                        ray r = get_ray<P>(i, j);
+                        aov_sample aov;
+                        auto sample_color = ray_color<P>(r, max_depth, world, camera_media, 0, &aov);
+                        buffers.add(i, j, sample_color, aov);
+                        active_sample_stream() = nullptr;
+                    }
+            }
+        }
     }
 
-    vec3 sample_square_stratified(int s_i, int s_j) const {
-        // 返回一个向量，指向由网格索引s_i和s_j指定的正方形子像素内的随机点，对于理想化的单位正方形像素[-.5,-.5]到[+.5,+.5]。
+    template <typename P>
+    ray get_ray(int i, int j) const { // 构建一条从散焦圆盘出发并指向像素位置i，j周围随机采样点的相机光线（依次使用像素内位置、镜头、时间三组维度）
+        auto offset = sample_square();
+        auto pixel_sample = pixel00_loc
+                          + ((i + offset.x()) * pixel_delta_u)
+                          + ((j + offset.y()) * pixel_delta_v);
 
-        auto px = ((s_i + random_double()) * recip_sqrt_spp) - 0.5;
-        auto py = ((s_j + random_double()) * recip_sqrt_spp) - 0.5;
+        auto ray_origin = P::thin_lens ? defocus_disk_sample() : center; // 如果焦平面模糊角度为0（即焦平面半径（光圈大小）为0），则光线从相机中心发出，否则从焦平面上的随机点发出
+        auto ray_direction = pixel_sample - ray_origin; // Ray的方向为从相机中心指向像素位置(i,j)周围的随机采样点
+        auto ray_time = P::motion_blur ? random_double() : 0.0; // 随机生成光线的时间（场景静止时不需要，时间维度空着，不影响之后的维度）
 
-        return vec3(px, py, 0);
+        return ray(ray_origin, ray_direction, ray_time, pixel_spread);
     }
 
     vec3 sample_square() const { // 返回指向 [-.5,-.5]-[+.5,+.5] 单位正方形中随机点的矢量。
-        return vec3(random_double() - 0.5, random_double() - 0.5, 0);
+        auto x = random_double();
+        auto y = random_double();
+        return vec3(x - 0.5, y - 0.5, 0);
     }
 
     point3 defocus_disk_sample() const { // 返回焦平面上的随机点
@@ -153,26 +273,580 @@ private:
         return center + (p[0] * defocus_disk_u) + (p[1] * defocus_disk_v);
     }
 
-    color ray_color(const ray& r, int depth, const hittable& world) const {
+    medium_stack probe_media(const hittable& world) const {
+        // 从相机沿一条固定方向的射线走出场景，记录穿过的带介质标记的表面：
+        // 某个介质第一次出现时是从内侧穿出，说明相机在它内部。越靠近相机的穿出越是内层，所以倒序入栈。
+        std::vector<const medium*> seen, inside;
+        ray r(center, vec3(0.0123, 1, 0.0345));
+        hit_record rec;
+
+        for (int i = 0; i < 1024 && world.hit(r, interval(0.001, infinity), rec); i++) {
+            rec.prim->finalize_hit(r, rec);
+            if (rec.inside && std::find(seen.begin(), seen.end(), rec.inside) == seen.end()) {
+                seen.push_back(rec.inside);
+                if (!rec.enters_inside) inside.push_back(rec.inside);
+            }
+            r = ray(rec.p, r.direction());
+        }
+
+        medium_stack media;
+        for (auto it = inside.rbegin(); it != inside.rend(); ++it)
+            media.enter(*it);
+        return media;
+    }
+
+    bool next_interaction(ray& r, const hittable& world, medium_stack& media, hit_record& rec, const hit_record* first = nullptr) const {
+        // 沿r找下一个相互作用点：当前介质中的散射点，或有材质的表面。自由程只针对已求出的最近表面采样一次；
+        // 穿过无材质的介质边界时切换介质并继续，r随之前移。返回false表示射线离开场景。
+        // first 非空时是射线包已经求出的第一次求交结果（prim 为空表示未命中）
+        count_cost(&cost_counters::path_segments);
+        auto t_min = 0.001;
+        auto boundaries_from = -infinity;
+        const medium* crossed = nullptr;    // 刚穿过的边界内侧的介质，下一次求交之后才切换
+        bool crossed_entering = false;
+        bool crossing = false;
+        for (int crossings = 0; crossings < max_crossings; crossings++) {
+            bool hit;
+            if (first && crossings == 0) {
+                hit = first->prim != nullptr;
+                if (hit) rec = *first;
+            } else {
+                hit = hit_world(world, r, t_min, boundaries_from, rec);
+            }
+
+            // 与刚穿过的边界重合的表面（如放在地板上的盒子底面下的地板）：穿越记在该表面上，散射射线透过它时才切换介质
+            bool coincident = crossing && hit && rec.t < boundaries_from;
+            if (crossing && !coincident) media.cross(crossed, crossed_entering);
+            crossing = false;
+
+            if (auto m = coincident ? nullptr : media.current()) {
+                double t;
+                if (m->sample_scatter(r, hit ? rec.t : infinity, t)) { // 在到达表面之前散射
+                    m->interaction(r, t, rec);
+                    return true;
+                }
+            }
+
+            if (!hit) return false;
+
+            rec.prim->finalize_hit(r, rec); // 只为最近交点计算着色数据
+            if (coincident) {
+                if (rec.mat) {
+                    rec.inside = crossed;
+                    rec.enters_inside = crossed_entering;
+                    return true;
+                }
+                media.cross(crossed, crossed_entering);
+            }
+            if (rec.mat) return true;
+
+            crossed = rec.inside; // 无材质的介质边界：只切换介质
+            crossed_entering = rec.enters_inside;
+            crossing = true;
+            r = ray(rec.p, r.direction(), r.time(), r.spread(), r.footprint(rec.t));
+            auto epsilon = crossing_epsilon(r);
+            t_min = -epsilon;           // 不跳过与边界重合的表面
+            boundaries_from = epsilon;  // 但跳过刚穿过的边界
+        }
+        return false;
+    }
+
+    static bool hit_world(const hittable& world, const ray& r, double t_min, double boundaries_from, hit_record& rec) {
+        // 求 t_min 之后的最近交点，参数t小于 boundaries_from 的介质边界不参与求交
+        rec.boundaries_from = boundaries_from;
+        bool hit = world.hit(r, interval(t_min, infinity), rec);
+        rec.boundaries_from = -infinity;
+        return hit;
+    }
+
+    static double crossing_epsilon(const ray& r) {
+        // 从介质边界（或朝光源）继续的射线，方向未归一化（朝光源时长度就是到光源的距离），
+        // 按参数t取0.001会跳过很长一段距离、漏掉紧挨着的边界，所以改为按距离取0.001
+        return 0.001 / r.direction().length();
+    }
+
+    static void update_media(const hit_record& rec, const scatter_record& srec, medium_stack& media) { // 散射射线穿过带介质标记的表面时切换介质
+        if (rec.inside && dot(srec.scattered.direction(), rec.normal) < 0) // 法线朝向入射一侧，点积为负表示透射到另一侧
+            media.cross(rec);
+    }
+
+    template <typename P>
+    color ray_color(const ray& r_in, int depth, const hittable& world, medium_stack media, double bsdf_pdf = 0,
+                    aov_sample* aov = nullptr, const hit_record* first = nullptr) const {
+        // media 为r_in起点所在的介质；bsdf_pdf 为上一个交点用BSDF采样到r_in方向的概率密度，0表示相机射线或镜面散射，此时命中光源不做MIS加权；
+        // aov 非空时写入路径的辅助输出（相机射线及其后的镜面反弹）；first 为射线包求出的r_in的第一次求交结果
         if (depth <= 0) // 如果超过光线反射的递归深度，则返回黑色
             return color(0,0,0);
 
+        if (auto stream = active_sample_stream()) // 本次反弹的介质、BSDF和光源采样使用本次反弹的维度
+            stream->start_bounce(max_depth - depth);
+
+        ray r = r_in;
         hit_record rec; // 记录射线与物体的交点信息
 
-        // 如果ray没有与任何物体相交，则返回背景颜色
-        if (!world.hit(r, interval(0.001, infinity), rec))
-            return background;
+        // 如果ray没有与任何物体（或介质）发生相互作用，则返回背景颜色
+        if (!next_interaction(r, world, media, rec, first)) {
+            if (aov) record_miss(r_in, *aov);
+            return miss<P>(r_in, bsdf_pdf);
+        }
 
-        ray scattered; // 散射的射线
-        color attenuation; // 衰减
-        color color_from_emission = rec.mat->emitted(rec.u, rec.v, rec.p); // 获取发射的颜色
+        scatter_record srec; // 材质采样记录（散射射线、BSDF值与概率密度）
+        color emission = rec.mat->emitted(rec.u, rec.v, rec.p);
+        color color_from_emission = emission * emission_weight(r_in, bsdf_pdf); // 获取发射的颜色
 
-        // 如果材质发生散射，则返回散射的射线和衰减
-        if (!rec.mat->scatter(r, rec, attenuation, scattered))
+        // 如果材质不发生散射，则只返回发射的颜色
+        bool scattered = rec.mat->scatter(r, rec, srec);
+        if (aov) record_hit(r_in, r, rec, scattered ? srec : scatter_record(), scattered ? color(0,0,0) : emission, *aov);
+        if (!scattered)
             return color_from_emission;
 
-        color color_from_scatter = attenuation * ray_color(scattered, depth-1, world); 
+        // 光源采样与下一次反弹得到的是同一长度的路径，所以最后一次反弹不做光源采样
+        color color_from_lights = (depth > 1 && !srec.is_specular) ? sample_lights(r, rec, world, media) : color(0,0,0);
+
+        update_media(rec, srec, media);
+        color color_from_scatter = srec.weight() * ray_color<P>(srec.scattered, depth-1, world, media, srec.is_specular ? 0 : srec.pdf,
+                                                             aov && !aov->done ? aov : nullptr); // 蒙特卡洛估计：f/pdf * 入射辐射亮度
+
+        return color_from_emission + color_from_lights + color_from_scatter;
+    }
+
+    void record_miss(const ray& r, aov_sample& aov) const { // 路径离开场景：反照率取背景（环境光）颜色
+        if (aov.done) return;
+        aov.albedo = clamp01(environment ? environment->value(r.direction()) : background);
+        aov.done = true;
+    }
+
+    static void record_hit(const ray& r_in, const ray& arrived, const hit_record& rec, const scatter_record& srec,
+                           const color& emission, aov_sample& aov) {
+        // 写入交点的辅助输出：相机射线的交点给出深度；镜面散射只记下法线，等后面的非镜面交点（或路径结束）再写入反照率。
+        // 非镜面散射的 f/pdf 按余弦采样的漫反射和相位函数正好是反照率；不散射的发光表面取发光值
+        if (aov.done) return;
+        if (aov.depth <= 0) aov.depth = (rec.p - r_in.origin()).length();
+
+        // 介质中的散射点没有表面法线，用朝向相机的方向，使同一团介质内部连续
+        aov.normal = rec.prim ? rec.normal : -unit_vector(arrived.direction());
+        if (srec.is_specular) return;
+
+        aov.albedo = clamp01(srec.pdf > 0 ? srec.weight() : emission);
+        aov.done = true;
+    }
+
+    static color clamp01(const color& c) {
+        return color(std::clamp(c.x(), 0.0, 1.0), std::clamp(c.y(), 0.0, 1.0), std::clamp(c.z(), 0.0, 1.0));
+    }
+
+    void write_aov_images(const render_buffers& buffers) const { // 输出辅助缓冲：反照率（伽马校正）、法线（映射到[0,1]）、深度（按最大深度归一化，近处亮）
+        std::vector<unsigned char> image(buffers.size() * channels);
+        auto save = [&](const char* filename) {
+            RTW_TRACE_ZONE("encode", filename);
+            stbi_write_png(filename, image_width, image_height, channels, image.data(), image_width * channels);
+        };
+
+        for (size_t k = 0; k < buffers.size(); k++)
+            write_color(int(k) * channels, image.data(), buffers.albedo(k));
+        save("..//output//albedo.png");
+
+        for (size_t k = 0; k < buffers.size(); k++) {
+            auto n = buffers.normal(k);
+            for (int c = 0; c < 3; c++)
+                image[k * channels + c] = n.near_zero() ? 0 : (unsigned char)(255.999 * std::clamp(0.5 * n[c] + 0.5, 0.0, 0.999));
+        }
+        save("..//output//normal.png");
+
+        double max_depth_seen = 0;
+        for (size_t k = 0; k < buffers.size(); k++) max_depth_seen = std::max(max_depth_seen, buffers.depth(k));
+        for (size_t k = 0; k < buffers.size(); k++) {
+            auto d = buffers.depth(k);
+            auto value = d > 0 ? (unsigned char)(255.999 * std::clamp(1 - d / max_depth_seen, 0.0, 0.999)) : 0;
+            for (int c = 0; c < 3; c++) image[k * channels + c] = value;
+        }
+        save("..//output//depth.png");
+    }
+
+    void write_cost_images(const cost_heatmap& costs) const { // 输出逐像素开销：伪彩色 cost_*.png 与原始数据 cost_*.pfm（每个样本的平均值）
+        for (int q = 0; q < cost_heatmap::quantity_count; q++) {
+            if (q != cost_heatmap::time_ns && !RTW_COST_COUNTERS) continue; // 没有编译计数时只有耗时
+            auto quantity = cost_heatmap::quantity(q);
+            RTW_TRACE_ZONE("encode", cost_heatmap::names[q]);
+            auto name = std::string("..//output//cost_") + cost_heatmap::names[q];
+            double scale, mean, peak;
+            auto image = costs.false_color_image(quantity, scale);
+            stbi_write_png((name + ".png").c_str(), image_width, image_height, 3, image.data(), image_width * 3);
+            costs.write_pfm(quantity, name + ".pfm");
+
+            costs.summary(quantity, mean, peak);
+            std::clog << "Cost " << cost_heatmap::names[q] << ": mean " << mean << ", max " << peak
+                      << ", colour scale 0-" << scale << ' ' << cost_heatmap::units[q] << " per sample\n";
+        }
+    }
+
+    static double power_heuristic(double pdf_a, double pdf_b) { // 幂启发式（β=2）的MIS权重
+        auto a2 = pdf_a * pdf_a;
+        auto b2 = pdf_b * pdf_b;
+        return a2 / (a2 + b2);
+    }
+
+    double emission_weight(const ray& r, double bsdf_pdf) const { // BSDF采样命中光源时的MIS权重
+        if (!lights || bsdf_pdf <= 0) return 1.0;
+        return power_heuristic(bsdf_pdf, lights->pdf_value(r.origin(), r.direction()));
+    }
+
+    template <typename P>
+    color miss(const ray& r, double bsdf_pdf) const { // 射线离开场景：环境光（按MIS加权）或背景颜色
+        if (!P::environment) return background;
+        return environment->value(r.direction()) * emission_weight(r, bsdf_pdf);
+    }
+
+    double shadow_transmittance(ray shadow, const hittable& world, medium_stack media, hit_record& lrec) const {
+        // 阴影射线：穿过无材质的介质边界，累计各段在所处介质中的透射率，lrec为最终命中的有材质表面。
+        // 离开场景时 lrec.mat 为空，有环境光时照常返回透射率（看到的是环境光），否则返回0
+        double tr = 1;
+        auto t_min = crossing_epsilon(shadow);
+        auto boundaries_from = -infinity;
+        for (int crossings = 0; crossings < max_crossings; crossings++) {
+            if (!hit_world(world, shadow, t_min, boundaries_from, lrec)) {
+                lrec.mat = nullptr;
+                return environment ? tr : 0;
+            }
+
+            if (auto m = media.current()) tr *= m->transmittance(shadow, 0, std::max(lrec.t, 0.0));
+            if (tr <= 0) return 0;
+
+            lrec.prim->finalize_hit(shadow, lrec);
+            if (lrec.mat) return tr;
+
+            media.cross(lrec);
+            shadow = ray(lrec.p, shadow.direction(), shadow.time());
+            t_min = -crossing_epsilon(shadow); // 与 next_interaction 相同：不跳过与边界重合的表面，只跳过刚穿过的边界
+            boundaries_from = -t_min;
+        }
+        return 0;
+    }
+
+    color sample_lights(const ray& r_in, const hit_record& rec, const hittable& world, const medium_stack& media) const {
+        // 朝光源列表采样一个方向，投射阴影射线，取其命中的发光值（乘以沿途介质的透射率），按光源采样的MIS权重累加
+        ray shadow;
+        medium_stack shadow_media;
+        color factor;
+        if (!sample_light_ray(r_in, rec, media, shadow, shadow_media, factor)) return color(0,0,0);
+        return factor * shadow_emission(shadow, world, shadow_media);
+    }
+
+    bool sample_light_ray(const ray& r_in, const hit_record& rec, const medium_stack& media,
+                          ray& shadow, medium_stack& shadow_media, color& factor) const {
+        // 光源采样的前半部分：采样方向，写入阴影射线、其起点的介质和未被遮挡时的系数 f * MIS权重 / 光源概率密度。贡献为0时返回false
+        if (!lights) return false;
+
+        auto direction = lights->random(rec.p);
+        auto light_pdf = lights->pdf_value(rec.p, direction);
+        if (light_pdf <= 0) return false;
+
+        auto f = rec.mat->eval(r_in, rec, direction);
+        if (f.near_zero()) return false;
+
+        // 阴影射线起点的介质：从表面朝另一侧射出时相当于穿过该表面
+        shadow_media = media;
+        if (rec.inside && dot(direction, rec.normal) < 0) shadow_media.cross(rec);
+
+        shadow = ray(rec.p, direction, r_in.time());
+        auto weight = power_heuristic(light_pdf, rec.mat->pdf(r_in, rec, direction));
+        factor = f * (weight / light_pdf);
+        return true;
+    }
+
+    color shadow_emission(const ray& shadow, const hittable& world, const medium_stack& shadow_media) const {
+        // 光源采样的后半部分：阴影射线命中的发光值乘以沿途介质的透射率
+        hit_record lrec;
+        auto tr = shadow_transmittance(shadow, world, shadow_media, lrec);
+        if (tr <= 0) // 没有命中任何物体（没有环境光时背景不作为光源采样）
+            return color(0,0,0);
+
+        // 被遮挡时命中的是非发光物体，发光值为0
+        auto emission = lrec.mat ? lrec.mat->emitted(lrec.u, lrec.v, lrec.p) : environment->value(shadow.direction());
+        return tr * emission;
+    }
+
+    template <typename P>
+    void trace_pixel_batched(int i, int j, const hittable& world, render_buffers& buffers) const {
+        // 把像素(i,j)的所有样本路径作为一批逐层推进：先对整批求交，再按材质类型分桶依次着色。
+        // 与逐条递归的 ray_color 计算相同的结果（累积的吞吐量代替递归中的衰减乘积），只是随机数的消耗顺序不同。
+        struct path {
+            ray r;              // 当前射线
+            color throughput;   // 路径吞吐量（之前所有衰减的乘积）
+            color radiance;     // 已累积的辐射亮度
+            double bsdf_pdf;    // 上一个交点BSDF采样到当前方向的概率密度（0表示相机射线或镜面散射）
+            medium_stack media; // 当前射线起点所在的介质
+            ray arrived;        // 到达本层交点的射线（穿过介质边界后的起点）
+            hit_record rec;     // 本层的交点
+            sampler samples;    // 本条路径的采样器状态（各条路径交替推进，维度各自计数）
+            aov_sample aov;     // 本条路径的辅助输出
+        };
+        thread_local std::vector<path> paths;
+        thread_local std::vector<int> active;
+        thread_local std::vector<int> buckets[material::kind_count]; // 每种材质类型一个桶
+
+        paths.clear();
+        active.clear();
+        for (int s = 0; s < samples_per_pixel; s++) {
+            auto samples = pixel_sampler;
+            samples.start_pixel_sample(i, j, s);
+            active.push_back(int(paths.size()));
+            paths.push_back({ray(), color(1,1,1), color(0,0,0), 0.0, camera_media, ray(), hit_record(), samples, aov_sample()});
+
+            auto& pa = paths.back();
+            active_sample_stream() = &pa.samples;
+            pa.r = get_ray<P>(i, j);
+        }
+
+        for (int depth = 0; depth < max_depth && !active.empty(); depth++) {
+            for (auto& bucket : buckets) bucket.clear();
+
+            for (int k : active) { // 整批求交，命中的路径按材质类型分桶
+                auto& pa = paths[k];
+                active_sample_stream() = &pa.samples;
+                pa.samples.start_bounce(depth);
+                pa.arrived = pa.r;
+                if (!next_interaction(pa.arrived, world, pa.media, pa.rec)) {
+                    record_miss(pa.r, pa.aov);
+                    pa.radiance += pa.throughput * miss<P>(pa.r, pa.bsdf_pdf);
+                    continue;
+                }
+                buckets[int(pa.rec.mat->type())].push_back(k);
+            }
+
+            active.clear();
+            for (const auto& bucket : buckets) // 逐桶着色
+                for (int k : bucket) {
+                    auto& pa = paths[k];
+                    active_sample_stream() = &pa.samples;
+                    auto emission = pa.rec.mat->emitted(pa.rec.u, pa.rec.v, pa.rec.p);
+                    pa.radiance += pa.throughput * emission * emission_weight(pa.r, pa.bsdf_pdf);
+
+                    scatter_record srec;
+                    bool scattered = pa.rec.mat->scatter(pa.arrived, pa.rec, srec);
+                    record_hit(pa.r, pa.arrived, pa.rec, scattered ? srec : scatter_record(), scattered ? color(0,0,0) : emission, pa.aov);
+                    if (!scattered)
+                        continue;
+                    if (depth < max_depth - 1 && !srec.is_specular)
+                        pa.radiance += pa.throughput * sample_lights(pa.arrived, pa.rec, world, pa.media);
+                    update_media(pa.rec, srec, pa.media);
+                    pa.throughput = pa.throughput * srec.weight();
+                    pa.bsdf_pdf = srec.is_specular ? 0 : srec.pdf;
+                    pa.r = srec.scattered;
+                    active.push_back(k);
+                }
+        }
+
+        active_sample_stream() = nullptr;
+
+        for (const auto& pa : paths)
+            buffers.add(i, j, pa.radiance, pa.aov);
+    }
+
+    template <typename P>
+    void trace_packets(const hittable& world, render_buffers& buffers) const {
+        // 相机射线成包追踪：图像按 4x2 或 4x4 像素分块，同一块同一样本序号的相机射线组成一个包，
+        // 整包遍历BVH求出第一次交点后，每条射线再各自用 ray_color 继续（结果与逐条追踪相同）
+        const int tile_w = 4, tile_h = packet_size > 8 ? 4 : 2;
+        ray_packet packet;
+        sampler samples[ray_packet::max_size];
+        int pixel_i[ray_packet::max_size], pixel_j[ray_packet::max_size];
+
+        for (int ty = 0; ty < image_height; ty += tile_h) {
+            RTW_TRACE_ZONE_ARG("render", "packet row", "row", ty);
+            std::clog << "\rScanlines remaining: " << (image_height - ty) << ' ' << std::flush;
+            for (int tx = 0; tx < image_width; tx += tile_w)
+                for (int s = 0; s < samples_per_pixel; s++) {
+                    packet.size = 0;
+                    for (int j = ty; j < std::min(ty + tile_h, image_height); j++)
+                        for (int i = tx; i < std::min(tx + tile_w, image_width); i++) {
+                            int k = packet.size;
+                            pixel_i[k] = i;
+                            pixel_j[k] = j;
+                            samples[k] = pixel_sampler;
+                            samples[k].start_pixel_sample(i, j, s);
+                            active_sample_stream() = &samples[k];
+                            packet.add(get_ray<P>(i, j));
+                        }
+
+                    packet.prepare();
+                    for (int k = 0; k < packet.size; k++) packet.recs[k] = hit_record(); // 与逐条追踪一样从空记录开始（prim 为空表示未命中）
+                    world.hit_packet(packet, packet.all(), 0.001);
+
+                    for (int k = 0; k < packet.size; k++) {
+                        active_sample_stream() = &samples[k];
+                        aov_sample aov;
+                        auto sample_color = ray_color<P>(packet.rays[k], max_depth, world, camera_media, 0, &aov, &packet.recs[k]);
+                        buffers.add(pixel_i[k], pixel_j[k], sample_color, aov);
+                    }
+                }
+        }
+        active_sample_stream() = nullptr;
+    }
+
+    template <typename P>
+    void trace_wavefront(const hittable& world, render_buffers& buffers) const {
+        // 波前积分器：把图像的所有样本路径按 wavefront_size 分批，每批依次执行
+        //   generate   生成相机射线，放进射线队列；
+        //   reorder    （sort_rays）第一次反弹之后的射线按起点和方向基数排序，路径状态随之重排并紧缩；
+        //   intersect  整个队列求交（含介质中的散射点），未命中的路径累加背景；
+        //   sort       按交点的材质类型计数排序；
+        //   shade      逐类型着色：累加发光，采样散射方向放进下一层的射线队列，光源采样放进阴影射线队列；
+        //   shadow     整个阴影射线队列求透射率和命中的发光值；
+        // 直到队列为空或达到最大深度。路径结束时把结果累加到像素。与 ray_color 计算相同的估计，只是随机数的消耗顺序不同。
+        wavefront_stats stats;
+        auto spp = size_t(samples_per_pixel);
+        auto total = size_t(image_width) * image_height * spp;
+        auto wave = std::min(total, size_t(std::max(1, wavefront_size)));
+
+        path_states paths; // 路径状态（按路径下标）
+
+        // 队列与逐射线的临时数据（按队列下标）
+        ray_queue current, next;
+        shadow_queue shadows;
+        std::vector<ray> arrived;
+        std::vector<hit_record> hits;
+        std::vector<int> order, kinds, survivors;
+        ray_sorter sorter;
+        current.reserve(wave);
+        next.reserve(wave);
+
+        auto finish = [&](int p) { // 路径结束：结果累加到像素
+            auto pixel = paths.sample_id[p] / spp;
+            buffers.add(int(pixel % image_width), int(pixel / image_width), paths.radiance[p], paths.aovs[p]);
+        };
+
+        for (size_t first = 0; first < total; first += wave) {
+            RTW_TRACE_ZONE_ARG("render", "wave", "first_path", first);
+            std::clog << "\rWaves remaining: " << (total - first + wave - 1) / wave << ' ' << std::flush;
+            auto n = std::min(wave, total - first);
+            stats.waves++;
+
+            {
+                wavefront_stats::timer t(stats, wavefront_stats::generate);
+                paths.resize(n);
+                current.clear();
+                for (size_t p = 0; p < n; p++) {
+                    auto id = first + p;
+                    auto pixel = id / spp;
+                    int i = int(pixel % image_width), j = int(pixel / image_width);
+                    paths.sample_id[p] = id;
+                    paths.samples[p] = pixel_sampler;
+                    paths.samples[p].start_pixel_sample(i, j, int(id % spp));
+                    paths.throughput[p] = color(1,1,1);
+                    paths.radiance[p] = color(0,0,0);
+                    paths.bsdf_pdf[p] = 0;
+                    paths.media[p] = camera_media;
+                    paths.aovs[p] = aov_sample();
+
+                    active_sample_stream() = &paths.samples[p];
+                    current.push(get_ray<P>(i, j), int(p));
+                }
+            }
+
+            for (int depth = 0; depth < max_depth && !current.empty(); depth++) {
+                if (sort_rays && depth > 0) { // 相机射线本来就是相干的，只重排之后的反弹
+                    wavefront_stats::timer t(stats, wavefront_stats::reorder);
+                    sorter.sort(current, order);
+                    survivors.resize(order.size());
+                    for (size_t k = 0; k < order.size(); k++) survivors[k] = current.path[order[k]];
+                    paths.compact(survivors);
+                    next.gather(current, order);
+                    for (size_t k = 0; k < next.size(); k++) next.path[k] = int(k);
+                    std::swap(current, next);
+                }
+
+                auto count = current.size();
+                arrived.resize(count);
+                hits.resize(count);
+                kinds.resize(count);
+
+                {
+                    wavefront_stats::timer t(stats, wavefront_stats::intersect);
+                    for (size_t k = 0; k < count; k++) {
+                        int p = current.path[k];
+                        active_sample_stream() = &paths.samples[p];
+                        paths.samples[p].start_bounce(depth);
+                        arrived[k] = current.get(k);
+                        if (next_interaction(arrived[k], world, paths.media[p], hits[k])) {
+                            kinds[k] = int(hits[k].mat->type());
+                            continue;
+                        }
+                        auto r = current.get(k);
+                        record_miss(r, paths.aovs[p]);
+                        paths.radiance[p] += paths.throughput[p] * miss<P>(r, paths.bsdf_pdf[p]);
+                        finish(p);
+                        kinds[k] = -1;
+                    }
+                }
+
+                {
+                    wavefront_stats::timer t(stats, wavefront_stats::sort);
+                    int offsets[material::kind_count + 1] = {};
+                    for (auto kind : kinds)
+                        if (kind >= 0) offsets[kind + 1]++;
+                    for (int m = 0; m < material::kind_count; m++) offsets[m + 1] += offsets[m];
+                    order.resize(offsets[material::kind_count]);
+                    for (size_t k = 0; k < count; k++)
+                        if (kinds[k] >= 0) order[offsets[kinds[k]]++] = int(k);
+                }
+
+                next.clear();
+                shadows.clear();
+                {
+                    wavefront_stats::timer t(stats, wavefront_stats::shade);
+                    for (int k : order) {
+                        int p = current.path[k];
+                        const auto& rec = hits[k];
+                        active_sample_stream() = &paths.samples[p];
+
+                        auto emission = rec.mat->emitted(rec.u, rec.v, rec.p);
+                        paths.radiance[p] += paths.throughput[p] * emission * emission_weight(current.get(k), paths.bsdf_pdf[p]);
+
+                        scatter_record srec;
+                        bool scattered = rec.mat->scatter(arrived[k], rec, srec);
+                        record_hit(current.get(k), arrived[k], rec, scattered ? srec : scatter_record(), scattered ? color(0,0,0) : emission, paths.aovs[p]);
+                        if (!scattered) {
+                            finish(p);
+                            continue;
+                        }
+
+                        ray shadow;
+                        medium_stack shadow_media;
+                        color factor;
+                        if (depth < max_depth - 1 && !srec.is_specular
+                            && sample_light_ray(arrived[k], rec, paths.media[p], shadow, shadow_media, factor))
+                            shadows.push(shadow, p, shadow_media, paths.throughput[p] * factor);
+
+                        update_media(rec, srec, paths.media[p]);
+                        paths.throughput[p] = paths.throughput[p] * srec.weight();
+                        paths.bsdf_pdf[p] = srec.is_specular ? 0 : srec.pdf;
+                        next.push(srec.scattered, p);
+                    }
+                }
+
+                {
+                    wavefront_stats::timer t(stats, wavefront_stats::shadow);
+                    for (size_t k = 0; k < shadows.size(); k++) {
+                        int p = shadows.path[k];
+                        active_sample_stream() = &paths.samples[p];
+                        paths.radiance[p] += shadows.factor[k] * shadow_emission(shadows.get(k), world, shadows.media[k]);
+                    }
+                }
+
+                stats.count_rays(depth, count, shadows.size());
+                std::swap(current, next);
+            }
+            active_sample_stream() = nullptr;
+
+            {
+                wavefront_stats::timer t(stats, wavefront_stats::accumulate);
+                for (size_t k = 0; k < current.size(); k++) // 达到最大深度的路径
+                    finish(current.path[k]);
+            }
+        }
 
-        return color_from_emission + color_from_scatter;
+        std::clog << "\r";
+        stats.report(std::clog);
     }
 };
\ No newline at end of file
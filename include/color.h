@@ -12,6 +12,10 @@ inline double linear_to_gamma(double linear_component) { // 线性颜色转伽
     return 0;
 }
 
+inline double luminance(const color& c) { // 线性颜色的亮度（Rec.709系数）
+    return 0.2126*c.x() + 0.7152*c.y() + 0.0722*c.z();
+}
+
 void write_color(int pixelIndex, unsigned char* data , const color& pixel_color) { // 写入每个坐标的颜色
     auto r = pixel_color.x();
     auto g = pixel_color.y();
@@ -3,72 +3,40 @@
 #include "rtweekend.h"
 
 #include "hittable.h"
-#include "material.h"
+#include "medium.h"
 #include "Texture.h"
 
 class constant_medium : public hittable {   // 恒定介质
+    // 只作为介质边界参与求交：hit() 返回的是边界面本身，交点带有内侧介质的标记，
+    // 路径在边界内的自由程由积分器根据介质栈采样（每段射线一次，针对已经求出的最近表面），不再重复求交边界。
+    // 边界应当没有材质：这时边界是折射率匹配的界面，射线穿过时只切换介质；边界可以与其他表面共面（如放在地板上的盒子），
+    // 穿越记在重合的表面上，只有射线透过该表面时才生效。
+    // 边界有材质时会作为真实表面渲染（如玻璃球本身就是介质的边界）。有材质的透射表面不能再与另一个无材质边界重合，
+    // 而是应当直接作为边界。介质互相重叠时只取最内层（最近进入）的一个。
 public:
     constant_medium(shared_ptr<hittable> boundary, double density, shared_ptr<Texture> tex)
-        : boundary(boundary), neg_inv_density(-1/density),
-          phase_function(make_shared<isotropic>(tex))
+        : boundary(boundary), fog(density, tex)
     {}
 
     constant_medium(shared_ptr<hittable> boundary, double density, const color& albedo)
-        : boundary(boundary), neg_inv_density(-1/density),
-          phase_function(make_shared<isotropic>(albedo))
+        : boundary(boundary), fog(density, albedo)
     {}
 
-    bool hit(const ray& r, interval ray_t, hit_record& rec) const override {    // 判断射线是否与物体相交（相交是否有效,即含射线区间判断）
-        // 调试时打印偶发样本。要启用此功能，请将 enableDebug 设置为 true。
-        const bool enableDebug = false;
-        const bool debugging = enableDebug && random_double() < 0.00001;
-
-        hit_record rec1, rec2;
-
-        if (!boundary->hit(r, interval::universe, rec1))
+    bool hit(const ray& r, interval ray_t, hit_record& rec) const override {    // 判断射线是否与介质边界相交
+        if (!boundary->hit(r, interval(std::max(ray_t.min, rec.boundaries_from), ray_t.max), rec))
             return false;
 
-        if (!boundary->hit(r, interval(rec1.t+0.0001, infinity), rec2))
-            return false;
-
-        if (debugging) std::clog << "\nt_min=" << rec1.t << ", t_max=" << rec2.t << '\n';
-
-        if (rec1.t < ray_t.min) rec1.t = ray_t.min;
-        if (rec2.t > ray_t.max) rec2.t = ray_t.max;
-
-        if (rec1.t >= rec2.t)
-            return false;
-
-        if (rec1.t < 0)
-            rec1.t = 0;
-
-        auto ray_length = r.direction().length();
-        auto distance_inside_boundary = (rec2.t - rec1.t) * ray_length;
-        auto hit_distance = neg_inv_density * log(random_double());
-
-        if (hit_distance > distance_inside_boundary)
-            return false;
-
-        rec.t = rec1.t + hit_distance / ray_length;
-        rec.p = r.at(rec.t);
-
-        if (debugging) {
-            std::clog << "hit_distance = " <<  hit_distance << '\n'
-                      << "rec.t = " <<  rec.t << '\n'
-                      << "rec.p = " <<  rec.p << '\n';
-        }
-
-        rec.normal = vec3(1,0,0);  // arbitrary
-        rec.front_face = true;     // also arbitrary
-        rec.mat = phase_function;
-
+        rec.inside = &fog; // prim 仍是边界上的图元，着色数据照常延迟计算
         return true;
     }
 
     aabb bounding_box() const override { return boundary->bounding_box(); }
 
+    bool has_motion() const override { return boundary->has_motion(); }
+
+    const medium& interior() const { return fog; } // 边界内的介质
+
 private:
     shared_ptr<hittable> boundary;  // 边界
-    double neg_inv_density; // 负介质密度
-    shared_ptr<material> phase_function;    // 相位函数（isotropic各向同性）
-};
\ No newline at end of file
+    homogeneous_medium fog;         // 边界内的均匀介质
+};
@@ -0,0 +1,108 @@
+#pragma once
+
+#include "rtweekend.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <vector>
+
+class cost_heatmap {
+    // 逐像素的渲染开销：耗时、BVH结点访问数、图元求交数、路径段数（都是每个样本的平均值），用来找出慢的区域，
+    // 比如互相重叠的介质和物体、包围盒划分得不好的BVH区域。每个量可以转成伪彩色图，或按 PFM 格式写出原始浮点数据
+public:
+    enum quantity { time_ns, bvh_nodes, primitive_tests, path_segments, quantity_count };
+    static constexpr const char* names[quantity_count] = {"time", "nodes", "prims", "path"};                     // 输出文件名中的名字
+    static constexpr const char* units[quantity_count] = {"ns", "BVH nodes", "primitive tests", "segments"};    // 单位（每个样本）
+
+    int width, height;
+
+    cost_heatmap(int width, int height)
+        : width(width), height(height), values(quantity_count, std::vector<float>(size_t(width) * height, 0.0f)) {}
+
+    class pixel_scope { // 作用域：构造时在当前线程上激活开销计数并开始计时，析构时写入像素(i,j)的开销；heatmap 为空时什么都不做
+    public:
+        pixel_scope(cost_heatmap* heatmap, int i, int j, int samples)
+            : heatmap(heatmap), i(i), j(j), samples(samples)
+        {
+            if (!heatmap) return;
+            active_cost_counters() = &counters;
+            start = std::chrono::steady_clock::now();
+        }
+
+        ~pixel_scope() {
+            if (!heatmap) return;
+            auto ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+            active_cost_counters() = nullptr;
+            heatmap->record(i, j, samples, ns, counters);
+        }
+
+    private:
+        cost_heatmap* heatmap;
+        int i, j, samples;
+        cost_counters counters;
+        std::chrono::steady_clock::time_point start;
+    };
+
+    void record(int i, int j, int samples, double ns, const cost_counters& counters) { // 写入像素(i,j)所有样本的总开销
+        auto k = size_t(j) * width + i;
+        auto n = double(std::max(1, samples));
+        values[time_ns][k] = float(ns / n);
+        values[bvh_nodes][k] = float(counters.bvh_nodes / n);
+        values[primitive_tests][k] = float(counters.primitive_tests / n);
+        values[path_segments][k] = float(counters.path_segments / n);
+    }
+
+    float value(quantity q, size_t k) const { return values[q][k]; }
+
+    std::vector<unsigned char> false_color_image(quantity q, double& scale) const {
+        // RGB 伪彩色图：按99百分位归一化（个别极慢的像素不会把其余部分压成一片暗色），scale 返回该上限
+        const auto& v = values[q];
+        scale = percentile(v, 0.99);
+        std::vector<unsigned char> image(v.size() * 3);
+        for (size_t k = 0; k < v.size(); k++) {
+            auto c = false_color(scale > 0 ? v[k] / scale : 0);
+            for (int a = 0; a < 3; a++) image[k * 3 + a] = (unsigned char)(255.999 * std::clamp(c[a], 0.0, 0.999));
+        }
+        return image;
+    }
+
+    void summary(quantity q, double& mean, double& peak) const { // 所有像素的均值与最大值
+        mean = peak = 0;
+        for (auto x : values[q]) {
+            mean += x / double(values[q].size());
+            peak = std::max(peak, double(x));
+        }
+    }
+
+    void write_pfm(quantity q, const std::string& filename) const {
+        // 单通道 PFM：文本头 "Pf 宽 高 -1"（负数表示小端），之后是从最下面一行开始的 float 数据
+        std::ofstream out(filename, std::ios::binary);
+        out << "Pf\n" << width << ' ' << height << "\n-1\n";
+        for (int j = height - 1; j >= 0; j--)
+            out.write(reinterpret_cast<const char*>(values[q].data() + size_t(j) * width), sizeof(float) * width);
+    }
+
+    static color false_color(double x) { // [0,1] 映射到 黑-蓝-青-绿-黄-红-白，超出1的部分是白色
+        static const color stops[] = {
+            color(0, 0, 0), color(0.1, 0.1, 0.7), color(0, 0.6, 0.9), color(0.1, 0.8, 0.2),
+            color(1, 0.85, 0), color(1, 0.1, 0), color(1, 1, 1)
+        };
+        const int last = int(sizeof stops / sizeof stops[0]) - 1;
+        auto s = std::clamp(x, 0.0, 1.0) * last;
+        auto k = std::min(int(s), last - 1);
+        auto f = s - k;
+        return (1 - f) * stops[k] + f * stops[k + 1];
+    }
+
+private:
+    std::vector<std::vector<float>> values; // 每个量一个缓冲，按行存储
+
+    static float percentile(std::vector<float> v, double p) {
+        if (v.empty()) return 0;
+        auto k = size_t(p * (v.size() - 1));
+        std::nth_element(v.begin(), v.begin() + k, v.end());
+        return v[k];
+    }
+};
\ No newline at end of file
@@ -0,0 +1,330 @@
+#pragma once
+
+#include "rtweekend.h"
+
+#include "color.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct aov_sample { // 一条样本路径的辅助输出（AOV）：第一个非镜面交点（穿过镜面反射、折射继续找）的反照率与法线，以及相机射线第一个交点的距离
+    color albedo = color(0,0,0);    // 漫反射反照率（发光表面取发光值截断到[0,1]，未命中时取背景颜色）
+    vec3 normal = vec3(0,0,0);      // 朝向入射一侧的单位法线，未命中时为0
+    double depth = 0;               // 相机射线到第一个交点的距离，未命中时为0
+    bool done = false;              // 已找到非镜面交点或路径已结束，之后的反弹不再写入
+};
+
+class render_buffers { // 逐像素累加的颜色与辅助缓冲：颜色、反照率、法线、深度，以及解调后光照亮度的一、二阶矩（估计每个像素的方差）
+public:
+    int width, height;
+
+    render_buffers(int width, int height)
+        : width(width), height(height), color_sum(size(), color(0,0,0)), albedo_sum(size(), color(0,0,0)),
+          normal_sum(size(), vec3(0,0,0)), depth_sum(size(), 0.0), moment1(size(), 0.0), moment2(size(), 0.0), count(size(), 0) {}
+
+    size_t size() const { return size_t(width) * height; }
+
+    void add(int i, int j, const color& c, const aov_sample& aov) { // 累加像素(i,j)的一个样本
+        auto k = size_t(j) * width + i;
+        color_sum[k] += c;
+        albedo_sum[k] += aov.albedo;
+        normal_sum[k] += aov.normal;
+        depth_sum[k] += aov.depth;
+
+        auto l = luminance(c / demodulation(aov.albedo));
+        moment1[k] += l;
+        moment2[k] += l * l;
+        count[k]++;
+    }
+
+    color beauty(size_t k) const { return color_sum[k] / std::max(1, count[k]); }   // 像素颜色（样本均值）
+    color albedo(size_t k) const { return albedo_sum[k] / std::max(1, count[k]); }  // 像素反照率
+    double depth(size_t k) const { return depth_sum[k] / std::max(1, count[k]); }   // 像素深度
+
+    vec3 normal(size_t k) const { // 像素法线（样本法线平均后归一化）
+        auto n = normal_sum[k];
+        return n.near_zero() ? vec3(0,0,0) : unit_vector(n);
+    }
+
+    double variance(size_t k) const { // 像素光照亮度均值的方差（样本方差除以样本数），样本数少于2时为0
+        if (count[k] < 2) return 0;
+        auto mean = moment1[k] / count[k];
+        auto var = (moment2[k] - count[k] * mean * mean) / (count[k] - 1);
+        return std::max(0.0, var) / count[k];
+    }
+
+    int samples(size_t k) const { return count[k]; }
+
+    static color demodulation(const color& albedo) { // 解调时除以的反照率（每个分量不小于0.01，避免黑色表面除以0）
+        return color(std::max(albedo.x(), 0.01), std::max(albedo.y(), 0.01), std::max(albedo.z(), 0.01));
+    }
+
+private:
+    std::vector<color> color_sum;   // 颜色之和
+    std::vector<color> albedo_sum;  // 反照率之和
+    std::vector<vec3> normal_sum;   // 法线之和
+    std::vector<double> depth_sum;  // 深度之和
+    std::vector<double> moment1;    // 解调后光照亮度之和
+    std::vector<double> moment2;    // 解调后光照亮度平方之和
+    std::vector<int> count;         // 样本数
+};
+
+class row_workers { // 按行并行的一组工作线程：构造时创建，之后每次 run() 都复用（降噪的十来个并行阶段共用一组线程），析构时结束
+public:
+    row_workers() {
+        int n = int(std::max(1u, std::thread::hardware_concurrency()));
+        for (int t = 1; t < n; t++) // 调用 run() 的线程也处理行，只需再创建 n-1 个（单核时不创建，直接在当前线程执行）
+            threads.emplace_back([this] { work(); });
+    }
+
+    row_workers(const row_workers&) = delete;
+    row_workers& operator=(const row_workers&) = delete;
+
+    ~row_workers() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto& t : threads) t.join();
+    }
+
+    template <typename F>
+    void run(int height, F&& row) { // 把 row(y) 按行分给所有线程执行，全部完成后返回
+        if (threads.empty()) {
+            for (int y = 0; y < height; y++) row(y);
+            return;
+        }
+
+        std::function<void(int)> f = [&](int y) { row(y); };
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            job = &f;
+            rows = height;
+            next = 0;
+            busy = int(threads.size());
+            generation++;
+        }
+        wake.notify_all();
+        drain();
+
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [&] { return busy == 0; });
+        job = nullptr;
+    }
+
+private:
+    std::vector<std::thread> threads;
+    std::mutex mutex;                       // 保护以下除 next 以外的成员
+    std::condition_variable wake, done;     // 有新任务 / 工作线程都已完成
+    const std::function<void(int)>* job = nullptr;
+    int rows = 0;
+    std::atomic<int> next{0};               // 下一个未分配的行
+    int busy = 0;                           // 本次任务中还没有完成的工作线程数
+    uint64_t generation = 0;                // 任务序号
+    bool stopping = false;
+
+    void drain() { // 领取并处理行，直到全部分完
+        RTW_TRACE_ZONE("parallel", "rows");
+        for (int y; (y = next++) < rows;) (*job)(y);
+    }
+
+    void work() {
+        RTW_TRACE_THREAD_NAME("worker");
+        uint64_t seen = 0;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [&] { return stopping || generation != seen; });
+                if (stopping) return;
+                seen = generation;
+            }
+            drain();
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--busy == 0) done.notify_one();
+        }
+    }
+};
+
+class atrous_denoiser {
+    // SVGF 的空间滤波部分（Schied et al. 2017，没有时间累积）：颜色先除以反照率得到光照，
+    // 再做 iterations 次 5x5 à-trous 小波滤波（第k次的采样间隔为2^k，有效半径随次数翻倍），
+    // 邻居的权重是 B3 样条核乘以法线、深度、光照亮度三个边缘停止函数；亮度的容差与像素的标准差成正比，方差随每次滤波一起更新。
+    // 最后乘回反照率，纹理细节不参与滤波。
+    // 所有缓冲按分量存成 float 平面，每个抽头对一整行连续的像素循环（无分支，编译器可以向量化），行之间多线程并行。
+public:
+    int iterations = 5;            // 滤波次数
+    double sigma_luminance = 4;    // 亮度边缘停止的容差（以标准差为单位）
+    double sigma_depth = 1;        // 深度边缘停止的容差（以深度梯度乘以偏移为单位）
+
+    std::vector<color> filter(const render_buffers& in) const { // 返回降噪后的颜色
+        int w = in.width, h = in.height;
+        auto n = in.size();
+
+        planes p(n), next(n);
+        std::vector<float> nx(n), ny(n), nz(n), z(n), gx(n), gy(n), sigma(n);
+        std::vector<color> modulation(n);
+
+        for (size_t k = 0; k < n; k++) { // 解调
+            modulation[k] = render_buffers::demodulation(in.albedo(k));
+            auto illum = in.beauty(k) / modulation[k];
+            p.r[k] = float(illum.x());
+            p.g[k] = float(illum.y());
+            p.b[k] = float(illum.z());
+            p.var[k] = float(in.variance(k));
+            auto nk = in.normal(k);
+            nx[k] = float(nk.x());
+            ny[k] = float(nk.y());
+            nz[k] = float(nk.z());
+            z[k] = float(in.depth(k));
+        }
+
+        row_workers workers;
+        depth_gradient(z, w, h, gx, gy);
+        if (in.samples(0) < 4) spatial_variance(workers, p, nx, ny, nz, w, h);
+
+        for (int iter = 0; iter < iterations; iter++) {
+            int step = 1 << iter;
+            RTW_TRACE_ZONE_ARG("denoise", "a-trous pass", "step", step);
+
+            workers.run(h, [&](int y) { // 亮度容差：3x3 高斯模糊后的方差开方（单像素的方差估计本身噪声很大）
+                for (int x = 0; x < w; x++) {
+                    double var = 0, wsum = 0;
+                    for (int dy = -1; dy <= 1; dy++)
+                        for (int dx = -1; dx <= 1; dx++) {
+                            int qx = x + dx, qy = y + dy;
+                            if (qx < 0 || qx >= w || qy < 0 || qy >= h) continue;
+                            double g = (dx ? 0.5 : 1.0) * (dy ? 0.5 : 1.0);
+                            var += g * p.var[size_t(qy) * w + qx];
+                            wsum += g;
+                        }
+                    sigma[size_t(y) * w + x] = float(sigma_luminance * std::sqrt(var / wsum)) + 1e-6f;
+                }
+            });
+
+            workers.run(h, [&](int y) { filter_row(p, next, nx, ny, nz, z, gx, gy, sigma, w, h, y, step); });
+            std::swap(p, next);
+        }
+
+        std::vector<color> out(n);
+        for (size_t k = 0; k < n; k++) // 乘回反照率
+            out[k] = color(p.r[k], p.g[k], p.b[k]) * modulation[k];
+        return out;
+    }
+
+private:
+    struct planes { // 光照的三个颜色分量与亮度方差
+        std::vector<float> r, g, b, var;
+        explicit planes(size_t n) : r(n), g(n), b(n), var(n) {}
+    };
+
+    static float luma(const planes& p, size_t k) { return 0.2126f*p.r[k] + 0.7152f*p.g[k] + 0.0722f*p.b[k]; }
+
+    static float normal_weight(float d) { // 法线边缘停止函数 max(0,n·n')^128（连续平方7次）
+        d = std::max(0.0f, d);
+        for (int i = 0; i < 7; i++) d *= d;
+        return d;
+    }
+
+    void filter_row(const planes& p, planes& out, const std::vector<float>& nx, const std::vector<float>& ny,
+                    const std::vector<float>& nz, const std::vector<float>& z, const std::vector<float>& gx,
+                    const std::vector<float>& gy, const std::vector<float>& sigma, int w, int h, int y, int step) const {
+        static const float kernel[3] = {3.0f/8, 1.0f/4, 1.0f/16}; // B3 样条核
+        thread_local std::vector<float> sw, sr, sg, sb, sv, lum;
+        sw.resize(w); sr.resize(w); sg.resize(w); sb.resize(w); sv.resize(w); lum.resize(w);
+
+        auto row = size_t(y) * w;
+        auto center = kernel[0] * kernel[0];
+        for (int x = 0; x < w; x++) { // 中心像素权重恒为核权重
+            auto k = row + x;
+            sw[x] = center;
+            sr[x] = center * p.r[k];
+            sg[x] = center * p.g[k];
+            sb[x] = center * p.b[k];
+            sv[x] = center * center * p.var[k];
+            lum[x] = luma(p, k);
+        }
+
+        auto zs = float(sigma_depth);
+        for (int dy = -2; dy <= 2; dy++) {
+            int qy = y + dy * step;
+            if (qy < 0 || qy >= h) continue;
+            for (int dx = -2; dx <= 2; dx++) {
+                if (dx == 0 && dy == 0) continue;
+                int off = dx * step;
+                int x0 = std::max(0, -off), x1 = std::min(w, w - off); // 邻居在图像内的像素范围
+                auto hk = kernel[std::abs(dx)] * kernel[std::abs(dy)];
+                auto ox = float(off), oy = float(dy * step);
+                auto qrow = size_t(qy) * w + off;
+
+                for (int x = x0; x < x1; x++) {
+                    auto k = row + x, q = qrow + x;
+                    auto wn = normal_weight(nx[k]*nx[q] + ny[k]*ny[q] + nz[k]*nz[q]);
+                    auto ez = std::abs(z[k] - z[q]) / (zs * std::abs(gx[k]*ox + gy[k]*oy) + 1e-3f * z[k] + 1e-6f);
+                    auto el = std::abs(lum[x] - luma(p, q)) / sigma[k];
+                    auto wq = hk * wn * rtw_exp(-ez - el);
+
+                    sw[x] += wq;
+                    sr[x] += wq * p.r[q];
+                    sg[x] += wq * p.g[q];
+                    sb[x] += wq * p.b[q];
+                    sv[x] += wq * wq * p.var[q];
+                }
+            }
+        }
+
+        for (int x = 0; x < w; x++) {
+            auto k = row + x;
+            out.r[k] = sr[x] / sw[x];
+            out.g[k] = sg[x] / sw[x];
+            out.b[k] = sb[x] / sw[x];
+            out.var[k] = sv[x] / (sw[x] * sw[x]);
+        }
+    }
+
+    static void depth_gradient(const std::vector<float>& z, int w, int h, std::vector<float>& gx, std::vector<float>& gy) {
+        // 屏幕空间的深度梯度：每个方向取前向、后向差分中绝对值较小的一个，轮廓处不会因为跨到背景而变得很大
+        auto diff = [](bool has_back, float back, bool has_fwd, float fwd) {
+            if (!has_back) return has_fwd ? fwd : 0.0f;
+            if (!has_fwd) return back;
+            return std::abs(back) < std::abs(fwd) ? back : fwd;
+        };
+        for (int y = 0; y < h; y++)
+            for (int x = 0; x < w; x++) {
+                auto k = size_t(y) * w + x;
+                gx[k] = diff(x > 0, x > 0 ? z[k] - z[k-1] : 0, x < w - 1, x < w - 1 ? z[k+1] - z[k] : 0);
+                gy[k] = diff(y > 0, y > 0 ? z[k] - z[k-w] : 0, y < h - 1, y < h - 1 ? z[k+w] - z[k] : 0);
+            }
+    }
+
+    static void spatial_variance(row_workers& workers, planes& p, const std::vector<float>& nx, const std::vector<float>& ny,
+                                 const std::vector<float>& nz, int w, int h) {
+        // 每个像素样本太少时无法估计方差，改用 7x7 邻域内法线相近的像素的亮度估计
+        std::vector<float> var(p.var.size());
+        workers.run(h, [&](int y) {
+            for (int x = 0; x < w; x++) {
+                auto k = size_t(y) * w + x;
+                float m1 = 0, m2 = 0, wsum = 0;
+                for (int qy = std::max(0, y - 3); qy <= std::min(h - 1, y + 3); qy++)
+                    for (int qx = std::max(0, x - 3); qx <= std::min(w - 1, x + 3); qx++) {
+                        auto q = size_t(qy) * w + qx;
+                        auto wq = q == k ? 1.0f : normal_weight(nx[k]*nx[q] + ny[k]*ny[q] + nz[k]*nz[q]);
+                        auto l = luma(p, q);
+                        m1 += wq * l;
+                        m2 += wq * l * l;
+                        wsum += wq;
+                    }
+                m1 /= wsum;
+                var[k] = std::max(0.0f, m2 / wsum - m1 * m1);
+            }
+        });
+        p.var = std::move(var);
+    }
+};
\ No newline at end of file
@@ -0,0 +1,123 @@
+#pragma once
+
+#include "rtweekend.h"
+
+#include "color.h"
+#include "hittable.h"
+#include "rtw_stb_image.h"
+
+#include <algorithm>
+
+class environment_light : public hittable {
+    // 无穷远处的环境光，辐射亮度由一张等距柱状投影（equirectangular）的图像给出：第0行朝 +y，经度与球体的纹理坐标 u 一致。
+    // 作为 camera::environment 时是射线未命中任何物体时的辐射亮度；同时加入光源列表时按亮度做重要性采样：
+    // 先按行的边缘分布、再按该行内的条件分布各做一次二分查找，O(log n) 选出一个像素。
+    // hit() 永远返回 false（不放进 world），也不参与 light_bvh（emitted_power() 为0），只适合放在 hittable_list 光源列表中。
+public:
+    environment_light(const char* image_filename, double scale = 1) { // 从HDR图像加载（也接受普通8位图像，按 gamma 2.2 线性化）
+        rtw_image image(image_filename, true);
+        width = std::max(1, image.width());
+        height = std::max(1, image.height());
+        pixels.resize(size_t(width) * height);
+        for (int j = 0; j < height; j++)
+            for (int i = 0; i < width; i++) {
+                auto p = image.hdr_pixel(i, j);
+                pixels[size_t(j) * width + i] = scale * color(p[0], p[1], p[2]);
+            }
+        build_distribution();
+    }
+
+    template <typename F>
+    environment_light(int width, int height, F radiance) : width(width), height(height), pixels(size_t(width) * height) {
+        // 由函数 radiance(单位方向) 生成 width*height 的环境图（在每个像素中心取值）
+        for (int j = 0; j < height; j++)
+            for (int i = 0; i < width; i++)
+                pixels[size_t(j) * width + i] = radiance(direction((i + 0.5) / width, (j + 0.5) / height));
+        build_distribution();
+    }
+
+    color value(const vec3& dir) const { // 方向dir（不必是单位向量）上的辐射亮度
+        double u, v;
+        to_uv(unit_vector(dir), u, v);
+        return pixels[size_t(row(v)) * width + column(u)];
+    }
+
+    bool hit(const ray& r, interval ray_t, hit_record& rec) const override { return false; }
+
+    aabb bounding_box() const override { return aabb::empty; }
+
+    double pdf_value(const point3& origin, const vec3& dir) const override {
+        // 立体角上的概率密度：(u,v)上的分段常数密度 / (2π² sinθ)
+        double u, v;
+        to_uv(unit_vector(dir), u, v);
+        auto sin_theta = rtw_sin(pi * v);
+        if (sin_theta <= 0 || total <= 0) return 0;
+
+        int j = row(v), i = column(u);
+        auto pdf_uv = weight(i, j) / total * width * height;
+        return pdf_uv / (2 * pi * pi * sin_theta);
+    }
+
+    vec3 random(const point3& origin) const override {
+        if (total <= 0) return vec3(0, 1, 0);
+
+        int j = sample(marginal.data(), height, random_double());
+        const double* cdf = &conditional[size_t(j) * (width + 1)];
+        int i = sample(cdf, width, random_double());
+
+        // 像素内均匀取一点
+        auto u = (i + random_double()) / width;
+        auto v = (j + random_double()) / height;
+        return direction(u, v);
+    }
+
+private:
+    int width = 1, height = 1;          // 环境图尺寸
+    std::vector<color> pixels;          // 辐射亮度（行优先，第0行朝 +y）
+    std::vector<double> marginal;       // 行的累积分布（height+1 个）
+    std::vector<double> conditional;    // 每行内像素的累积分布（每行 width+1 个）
+    double total = 0;                   // 所有像素权重之和
+
+    static vec3 direction(double u, double v) { // (u,v) -> 单位方向；v为从 +y 量起的极角/π
+        double sin_theta, cos_theta, sin_phi, cos_phi;
+        rtw_sincos(pi * v, sin_theta, cos_theta);
+        rtw_sincos(2 * pi * u, sin_phi, cos_phi);
+        return vec3(-sin_theta * cos_phi, cos_theta, sin_theta * sin_phi);
+    }
+
+    static void to_uv(const vec3& d, double& u, double& v) { // 单位方向 -> (u,v)，与 direction() 互逆
+        v = rtw_acos(std::clamp(d.y(), -1.0, 1.0)) / pi;
+        u = (rtw_atan2(-d.z(), d.x()) + pi) / (2 * pi);
+    }
+
+    int row(double v) const { return std::min(height - 1, std::max(0, int(v * height))); }
+    int column(double u) const { return std::min(width - 1, std::max(0, int(u * width))); }
+
+    double weight(int i, int j) const { // 像素的采样权重：亮度乘以该行中心的 sinθ（等距柱状投影中靠近两极的像素对应的立体角更小）
+        return luminance(pixels[size_t(j) * width + i]) * std::sin(pi * (j + 0.5) / height);
+    }
+
+    void build_distribution() { // 建立边缘分布与条件分布
+        marginal.assign(height + 1, 0.0);
+        conditional.assign(size_t(height) * (width + 1), 0.0);
+
+        for (int j = 0; j < height; j++) {
+            double* cdf = &conditional[size_t(j) * (width + 1)];
+            for (int i = 0; i < width; i++)
+                cdf[i+1] = cdf[i] + std::max(0.0, weight(i, j));
+            marginal[j+1] = marginal[j] + cdf[width];
+
+            if (cdf[width] > 0)
+                for (int i = 1; i <= width; i++) cdf[i] /= cdf[width];
+        }
+
+        total = marginal[height];
+        if (total > 0)
+            for (int j = 1; j <= height; j++) marginal[j] /= total;
+    }
+
+    static int sample(const double* cdf, int n, double xi) { // 二分查找：cdf[k] <= xi < cdf[k+1]，跳过概率为0的项
+        int k = int(std::upper_bound(cdf, cdf + n + 1, xi) - cdf) - 1;
+        return std::min(n - 1, std::max(0, k));
+    }
+};
\ No newline at end of file
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+
+// 为 1 时 rtw_atan2/rtw_acos/rtw_log/rtw_exp/rtw_sincos 等使用下面的快速近似（fast_*），为 0 时调用标准库。
+// 近似误差都在 1e-7 以下，远小于蒙特卡洛噪声；打开后各场景的差别见提交说明
+#ifndef RTW_FAST_MATH
+#define RTW_FAST_MATH 0
+#endif
+
+// 快速近似：只用加减乘除、sqrt、比较选择和位运算，不调用 libm，可以内联，放在循环里也能向量化。
+// 注释里的误差是在给出的范围内密集取点、与 std:: 版本比较得到的最大误差。
+// 参数超出范围或是 0、无穷大、NaN 等特殊值时，fast_log/fast_exp 退回标准库，其余函数的结果没有保证
+
+// 本文件由 vec3.h 包含，不能依赖 rtweekend.h 中的常量（rtweekend.h 又包含 vec3.h），需要的常量在这里单独定义
+constexpr double fast_math_pi = 3.1415926535897932385;
+constexpr double fast_math_infinity = std::numeric_limits<double>::infinity();
+
+inline uint64_t double_bits(double x) { uint64_t b; std::memcpy(&b, &x, sizeof b); return b; }
+inline double bits_double(uint64_t b) { double x; std::memcpy(&x, &b, sizeof x); return x; }
+
+inline double round_nearest(double x) { // 就近取整（|x| < 2^51）：加减 1.5*2^52 把小数部分舍掉，不依赖 SSE4.1 的 roundsd
+    const double magic = 6755399441055744.0;
+    return (x + magic) - magic;
+}
+
+inline double pow5(double x) { // x^5：三次乘法（std::pow 只有在 -ffast-math 下才会展开）
+    auto x2 = x * x;
+    return x2 * x2 * x;
+}
+
+inline double fast_atan2(double y, double x) { // 最大绝对误差 3.8e-8（弧度）
+    // 化到 [0,1] 上的 atan(a)，a = min/max；a*P(a^2) 是用 Lawson 迭代拟合的15次奇多项式（近似最小最大）
+    auto ax = std::fabs(x), ay = std::fabs(y);
+    auto hi = ax < ay ? ay : ax, lo = ax < ay ? ax : ay;
+    auto a = hi > 0 ? lo / hi : 0.0;
+    auto z = a * a;
+    auto r = a * (0.99999933528008922 + z * (-0.33329859624819491 + z * (0.19946552904191925 + z * (-0.13908568246398625
+             + z * (0.096420465376959155 + z * (-0.055910344375304823 + z * (0.021861632225212743 + z * -0.0040542128939018837)))))));
+    r = ay > ax ? fast_math_pi / 2 - r : r;
+    r = x < 0 ? fast_math_pi - r : r;
+    return std::copysign(r, y);
+}
+
+inline double fast_acos(double x) { // x∈[-1,1]，最大绝对误差 2.2e-8（Abramowitz & Stegun 4.4.46）
+    auto a = std::fabs(x);
+    a = a < 1 ? a : 1.0;
+    auto r = std::sqrt(1 - a) * (1.5707963050 + a * (-0.2145988016 + a * (0.0889789874 + a * (-0.0501743046
+             + a * (0.0308918810 + a * (-0.0170881256 + a * (0.0066700901 + a * -0.0012624911)))))));
+    return x < 0 ? fast_math_pi - r : r;
+}
+
+inline void fast_sincos(double x, double& s, double& c) { // |x| <= 1e5，最大绝对误差 2e-9
+    // 按 π/2 化简到 [-π/4,π/4]（π/2 拆成高低两部分减，k 不大时化简是精确的），再用 9 次和 10 次泰勒多项式，按象限交换、变号
+    auto k = round_nearest(x * (2 / fast_math_pi));
+    auto r = (x - k * 1.57079632673412561417) - k * 6.07710050650619224932e-11;
+    auto r2 = r * r;
+    auto sr = r + r * r2 * (-1.0/6 + r2 * (1.0/120 + r2 * (-1.0/5040 + r2 * (1.0/362880))));
+    auto cr = 1 + r2 * (-0.5 + r2 * (1.0/24 + r2 * (-1.0/720 + r2 * (1.0/40320 + r2 * (-1.0/3628800)))));
+    auto q = int64_t(k) & 3;
+    s = (q & 1) ? cr : sr;
+    c = (q & 1) ? sr : cr;
+    s = (q & 2) ? -s : s;
+    c = ((q + 1) & 2) ? -c : c;
+}
+
+inline double fast_sin(double x) { double s, c; fast_sincos(x, s, c); return s; }
+inline double fast_cos(double x) { double s, c; fast_sincos(x, s, c); return c; }
+
+struct log_table_entry { double inv_c, log_c; };
+
+inline const log_table_entry* log_table() { // fast_log 的查找表：尾数 [1,2) 按高7位分成128段，存每段中点c的 1/c 和 ln c
+    static const auto table = [] {
+        struct { log_table_entry e[128]; } t;
+        for (int i = 0; i < 128; i++) {
+            auto c = 1 + (i + 0.5) / 128;
+            t.e[i] = {1 / c, std::log(c)};
+        }
+        return t;
+    }();
+    return table.e;
+}
+
+inline double fast_log(double x) { // x 为正规数，最大绝对误差 2e-13
+    // x = m * 2^e，m∈[1,2)；按尾数高7位查表得 c，ln m = ln c + ln(1+r)，r = m/c - 1，|r| < 1/256，ln(1+r) 取4次泰勒多项式。
+    // 不用除法：在路径追踪里它处在“采样自由程 -> 比较”的依赖链上，除法的延迟比标准库还慢
+    if (!(x >= 2.2250738585072014e-308 && x < fast_math_infinity)) return std::log(x);
+    auto b = double_bits(x);
+    auto e = double(int64_t(b >> 52) - 1023);
+    const auto& entry = log_table()[(b >> 45) & 127];
+    auto m = bits_double((b & 0x000fffffffffffffull) | 0x3ff0000000000000ull);
+    auto r = m * entry.inv_c - 1;
+    auto r2 = r * r;
+    return e * 0.69314718055994530942 + entry.log_c + (r - r2 * (1.0/2 - r * (1.0/3))) - r2 * r2 * (1.0/4);
+}
+
+inline double fast_exp(double x) { // x∈(-708,709)，最大相对误差 3e-10
+    // x = k ln2 + r，|r| <= ln2/2，e^r 用 8 次泰勒多项式，2^k 直接拼出指数位
+    if (!(x > -708 && x < 709)) return std::exp(x);
+    auto k = round_nearest(x * 1.44269504088896340736);
+    auto r = (x - k * 6.93147180369123816490e-01) - k * 1.90821492927058770002e-10;
+    auto r2 = r * r; // Estrin 形式：两半并行计算，依赖链比 Horner 短
+    auto p = (1 + r + r2 * (1.0/2 + r * (1.0/6))) + r2 * r2 * ((1.0/24 + r * (1.0/120)) + r2 * (1.0/720 + r * (1.0/5040 + r * (1.0/40320))));
+    return p * bits_double(uint64_t(int64_t(k) + 1023) << 52);
+}
+
+// 由 RTW_FAST_MATH 选择的版本，热点路径上的调用都用这些
+#if RTW_FAST_MATH
+inline double rtw_atan2(double y, double x) { return fast_atan2(y, x); }
+inline double rtw_acos(double x) { return fast_acos(x); }
+inline double rtw_asin(double x) { return fast_math_pi / 2 - fast_acos(x); }
+inline void rtw_sincos(double x, double& s, double& c) { fast_sincos(x, s, c); }
+inline double rtw_sin(double x) { return fast_sin(x); }
+inline double rtw_cos(double x) { return fast_cos(x); }
+inline double rtw_log(double x) { return fast_log(x); }
+inline double rtw_exp(double x) { return fast_exp(x); }
+#else
+inline double rtw_atan2(double y, double x) { return std::atan2(y, x); }
+inline double rtw_acos(double x) { return std::acos(x); }
+inline double rtw_asin(double x) { return std::asin(x); }
+inline void rtw_sincos(double x, double& s, double& c) { s = std::sin(x); c = std::cos(x); }
+inline double rtw_sin(double x) { return std::sin(x); }
+inline double rtw_cos(double x) { return std::cos(x); }
+inline double rtw_log(double x) { return std::log(x); }
+inline double rtw_exp(double x) { return std::exp(x); }
+#endif
\ No newline at end of file
@@ -0,0 +1,371 @@
+#pragma once
+
+#include "rtweekend.h"
+
+#include "AABB.h"
+#include "hittable.h"
+#include "medium.h"
+#include "Quad.h"
+
+#include <algorithm>
+#include <cstdint>
+
+class dense_grid { // 稠密密度网格：nx*ny*nz 个体素连续存放（x最快变化）
+public:
+    template <typename F>
+    dense_grid(int nx, int ny, int nz, F density) : n{nx, ny, nz}, data(size_t(nx) * ny * nz) { // density(x,y,z) 给出体素的密度
+        for (int z = 0; z < nz; z++)
+            for (int y = 0; y < ny; y++)
+                for (int x = 0; x < nx; x++)
+                    data[(size_t(z) * ny + y) * nx + x] = float(density(x, y, z));
+    }
+
+    int size(int axis) const { return n[axis]; }
+
+    float at(int x, int y, int z) const { return data[(size_t(z) * n[1] + y) * n[0] + x]; } // 坐标须在网格内
+
+    void corners(int x, int y, int z, float v[8]) const { // 从(x,y,z)起2x2x2个体素的密度（三线性插值用，网格外为0）
+        if (x >= 0 && y >= 0 && z >= 0 && x + 1 < n[0] && y + 1 < n[1] && z + 1 < n[2]) {
+            auto p = &data[(size_t(z) * n[1] + y) * n[0] + x];
+            auto slice = size_t(n[0]) * n[1];
+            v[0] = p[0];            v[1] = p[1];
+            v[2] = p[n[0]];         v[3] = p[n[0] + 1];
+            v[4] = p[slice];        v[5] = p[slice + 1];
+            v[6] = p[slice + n[0]]; v[7] = p[slice + n[0] + 1];
+            return;
+        }
+        for (int i = 0; i < 8; i++) {
+            int cx = x + (i & 1), cy = y + ((i >> 1) & 1), cz = z + (i >> 2);
+            bool inside = cx >= 0 && cy >= 0 && cz >= 0 && cx < n[0] && cy < n[1] && cz < n[2];
+            v[i] = inside ? at(cx, cy, cz) : 0.0f;
+        }
+    }
+
+    float max_in(int x0, int y0, int z0, int x1, int y1, int z1) const { // 体素区域 [x0,x1]×[y0,y1]×[z0,z1] 内的最大密度
+        float m = 0;
+        for (int z = z0; z <= z1; z++)
+            for (int y = y0; y <= y1; y++)
+                for (int x = x0; x <= x1; x++)
+                    m = std::max(m, at(x, y, z));
+        return m;
+    }
+
+    size_t memory_bytes() const { return data.size() * sizeof(float); }
+
+private:
+    int n[3];                   // 各轴体素数
+    std::vector<float> data;    // 密度
+};
+
+class brick_grid { // 稀疏分块密度网格：按 8x8x8 体素分块，全空的块不分配存储，适合大范围中只有局部有烟的场景
+public:
+    static const int brick_size = 8;                                    // 块边长（体素）
+    static const int brick_voxels = brick_size * brick_size * brick_size; // 每块体素数
+
+    template <typename F>
+    brick_grid(int nx, int ny, int nz, F density) : n{nx, ny, nz} { // 逐块求值，整块为0时丢弃
+        for (int a = 0; a < 3; a++) bricks[a] = (n[a] + brick_size - 1) / brick_size;
+        index.assign(size_t(bricks[0]) * bricks[1] * bricks[2], -1);
+
+        float values[brick_voxels];
+        for (int bz = 0; bz < bricks[2]; bz++)
+            for (int by = 0; by < bricks[1]; by++)
+                for (int bx = 0; bx < bricks[0]; bx++) {
+                    float m = 0;
+                    for (int i = 0; i < brick_voxels; i++) {
+                        int x = bx * brick_size + i % brick_size;
+                        int y = by * brick_size + (i / brick_size) % brick_size;
+                        int z = bz * brick_size + i / (brick_size * brick_size);
+                        values[i] = (x < nx && y < ny && z < nz) ? float(density(x, y, z)) : 0.0f;
+                        m = std::max(m, values[i]);
+                    }
+                    if (m <= 0) continue;
+
+                    index[(size_t(bz) * bricks[1] + by) * bricks[0] + bx] = int32_t(brick_max.size());
+                    brick_max.push_back(m);
+                    pool.insert(pool.end(), values, values + brick_voxels);
+                }
+    }
+
+    int size(int axis) const { return n[axis]; }
+
+    float at(int x, int y, int z) const { // 坐标须在网格内
+        auto b = index[(size_t(z / brick_size) * bricks[1] + y / brick_size) * bricks[0] + x / brick_size];
+        if (b < 0) return 0;
+        return pool[size_t(b) * brick_voxels + ((z % brick_size) * brick_size + y % brick_size) * brick_size + x % brick_size];
+    }
+
+    void corners(int x, int y, int z, float v[8]) const {
+        // 从(x,y,z)起2x2x2个体素的密度（网格外为0）。8个体素落在同一块内时（大多数情况）只查一次块索引
+        const int last = brick_size - 1;
+        if (x >= 0 && y >= 0 && z >= 0 && x % brick_size < last && y % brick_size < last && z % brick_size < last
+            && x + 1 < n[0] && y + 1 < n[1] && z + 1 < n[2]) {
+            auto b = index[(size_t(z / brick_size) * bricks[1] + y / brick_size) * bricks[0] + x / brick_size];
+            if (b < 0) {
+                for (int i = 0; i < 8; i++) v[i] = 0;
+                return;
+            }
+            auto p = &pool[size_t(b) * brick_voxels + ((z % brick_size) * brick_size + y % brick_size) * brick_size + x % brick_size];
+            const int row = brick_size, slice = brick_size * brick_size;
+            v[0] = p[0];           v[1] = p[1];
+            v[2] = p[row];         v[3] = p[row + 1];
+            v[4] = p[slice];       v[5] = p[slice + 1];
+            v[6] = p[slice + row]; v[7] = p[slice + row + 1];
+            return;
+        }
+        for (int i = 0; i < 8; i++) {
+            int cx = x + (i & 1), cy = y + ((i >> 1) & 1), cz = z + (i >> 2);
+            bool inside = cx >= 0 && cy >= 0 && cz >= 0 && cx < n[0] && cy < n[1] && cz < n[2];
+            v[i] = inside ? at(cx, cy, cz) : 0.0f;
+        }
+    }
+
+    float max_in(int x0, int y0, int z0, int x1, int y1, int z1) const {
+        // 区域内的最大密度：跳过全空的块；区域覆盖整块时直接用块的最大值，否则逐个体素比较（上界越紧，空碰撞越少）
+        float m = 0;
+        for (int bz = z0 / brick_size; bz <= z1 / brick_size; bz++)
+            for (int by = y0 / brick_size; by <= y1 / brick_size; by++)
+                for (int bx = x0 / brick_size; bx <= x1 / brick_size; bx++) {
+                    auto b = index[(size_t(bz) * bricks[1] + by) * bricks[0] + bx];
+                    if (b < 0 || brick_max[b] <= m) continue;
+
+                    int lo[3] = {std::max(x0, bx * brick_size), std::max(y0, by * brick_size), std::max(z0, bz * brick_size)};
+                    int hi[3] = {std::min(x1, bx * brick_size + brick_size - 1), std::min(y1, by * brick_size + brick_size - 1),
+                                 std::min(z1, bz * brick_size + brick_size - 1)};
+                    if (hi[0] - lo[0] == brick_size - 1 && hi[1] - lo[1] == brick_size - 1 && hi[2] - lo[2] == brick_size - 1) {
+                        m = brick_max[b];
+                        continue;
+                    }
+                    for (int z = lo[2]; z <= hi[2]; z++)
+                        for (int y = lo[1]; y <= hi[1]; y++)
+                            for (int x = lo[0]; x <= hi[0]; x++)
+                                m = std::max(m, at(x, y, z));
+                }
+        return m;
+    }
+
+    size_t brick_count() const { return brick_max.size(); } // 已分配的块数
+
+    size_t memory_bytes() const {
+        return pool.size() * sizeof(float) + index.size() * sizeof(int32_t) + brick_max.size() * sizeof(float);
+    }
+
+private:
+    int n[3];                       // 各轴体素数
+    int bricks[3];                  // 各轴块数
+    std::vector<int32_t> index;     // 块在 pool 中的序号，-1 表示全空
+    std::vector<float> pool;        // 已分配块的密度（每块 brick_voxels 个）
+    std::vector<float> brick_max;   // 每块的最大密度
+};
+
+template <typename Grid>
+class grid_medium : public medium { // 非均匀介质：密度由网格在包围盒内三线性插值给出
+    // 自由程用 delta tracking、透射率用 ratio tracking 估计，都是无偏的。密度上界（majorant）取自一个粗网格，
+    // 每个粗格覆盖 8x8x8 个体素，射线用 3D DDA 逐格前进，在每个格子里按该格的上界采样候选碰撞，
+    // 上界为0的空格子直接跳过。
+public:
+    static const int cell_size = 8; // 粗格边长（体素）
+
+    double march_step = 0; // 大于0时改用该步长（世界空间距离）的定步长光线步进，有偏，只用于对比
+
+    grid_medium(Grid grid, const aabb& bounds, double density_scale, const color& albedo)
+        : medium(albedo), grid(std::move(grid)), bounds(bounds), scale(density_scale)
+    {
+        for (int a = 0; a < 3; a++) {
+            n[a] = this->grid.size(a);
+            cells[a] = (n[a] + cell_size - 1) / cell_size;
+            voxel[a] = bounds.axis_interval(a).size() / n[a];
+        }
+
+        // 三线性插值会用到相邻体素，所以每个粗格的上界向外多取一个体素
+        majorants.resize(size_t(cells[0]) * cells[1] * cells[2]);
+        for (int cz = 0; cz < cells[2]; cz++)
+            for (int cy = 0; cy < cells[1]; cy++)
+                for (int cx = 0; cx < cells[0]; cx++) {
+                    int c[3] = {cx, cy, cz}, lo[3], hi[3];
+                    for (int a = 0; a < 3; a++) {
+                        lo[a] = std::max(0, c[a] * cell_size - 1);
+                        hi[a] = std::min(n[a] - 1, (c[a] + 1) * cell_size);
+                    }
+                    majorants[(size_t(cz) * cells[1] + cy) * cells[0] + cx]
+                        = scale * this->grid.max_in(lo[0], lo[1], lo[2], hi[0], hi[1], hi[2]);
+                }
+    }
+
+    const aabb& bounding_box() const { return bounds; }
+
+    double density(const point3& p) const { // p处的消光系数（三线性插值，体素中心在 i+0.5）
+        double g[3];
+        int i[3];
+        for (int a = 0; a < 3; a++) {
+            g[a] = (p[a] - bounds.axis_interval(a).min) / voxel[a] - 0.5;
+            i[a] = int(std::floor(g[a]));
+            g[a] -= i[a];
+        }
+
+        float v[8];
+        grid.corners(i[0], i[1], i[2], v);
+        auto x0 = v[0] + g[0] * (v[1] - v[0]), x1 = v[2] + g[0] * (v[3] - v[2]);
+        auto x2 = v[4] + g[0] * (v[5] - v[4]), x3 = v[6] + g[0] * (v[7] - v[6]);
+        auto y0 = x0 + g[1] * (x1 - x0), y1 = x2 + g[1] * (x3 - x2);
+        return scale * (y0 + g[2] * (y1 - y0));
+    }
+
+    bool sample_scatter(const ray& r, double t_max, double& t) const override {
+        double t0, t1;
+        if (!clip(r, t_max, t0, t1)) return false;
+        if (march_step > 0) return march_scatter(r, t0, t1, t);
+
+        auto length = r.direction().length();
+        bool scattered = false;
+        traverse(r, t0, t1, [&](double ta, double tb, double majorant) { // delta tracking
+            if (majorant <= 0) return false;
+            auto rate = majorant * length; // 每单位t的候选碰撞率
+            for (auto tt = ta;;) {
+                tt -= rtw_log(1 - random_double()) / rate;
+                if (tt >= tb) return false;
+                if (random_double() * majorant < density(r.at(tt))) { // 真实碰撞
+                    t = tt;
+                    scattered = true;
+                    return true;
+                }
+            }
+        });
+        return scattered;
+    }
+
+    double transmittance(const ray& r, double t_min, double t_max) const override {
+        double t0, t1;
+        if (!clip(r, t_max, t0, t1)) return 1;
+        t0 = std::max(t0, t_min);
+        if (t0 >= t1) return 1;
+        if (march_step > 0) return march_transmittance(r, t0, t1);
+
+        auto length = r.direction().length();
+        double tr = 1;
+        traverse(r, t0, t1, [&](double ta, double tb, double majorant) { // ratio tracking
+            if (majorant <= 0) return false;
+            auto rate = majorant * length;
+            for (auto tt = ta;;) {
+                tt -= rtw_log(1 - random_double()) / rate;
+                if (tt >= tb) return false;
+                tr *= 1 - density(r.at(tt)) / majorant;
+                if (tr <= 0) return true;
+            }
+        });
+        return std::max(tr, 0.0);
+    }
+
+private:
+    Grid grid;                      // 密度网格
+    aabb bounds;                    // 网格在世界空间的范围
+    double scale;                   // 密度到消光系数的缩放
+    int n[3];                       // 各轴体素数
+    int cells[3];                   // 各轴粗格数
+    double voxel[3];                // 体素在世界空间的尺寸
+    std::vector<double> majorants;  // 每个粗格的消光系数上界
+
+    bool clip(const ray& r, double t_max, double& t0, double& t1) const { // 射线 [0, t_max) 与包围盒的交集
+        t0 = 0;
+        t1 = t_max;
+        for (int a = 0; a < 3; a++) {
+            const auto& ax = bounds.axis_interval(a);
+            auto inv = 1.0 / r.direction()[a];
+            auto ta = (ax.min - r.origin()[a]) * inv;
+            auto tb = (ax.max - r.origin()[a]) * inv;
+            if (ta > tb) std::swap(ta, tb);
+            t0 = std::max(t0, ta);
+            t1 = std::min(t1, tb);
+        }
+        return t0 < t1;
+    }
+
+    template <typename F>
+    void traverse(const ray& r, double t0, double t1, F&& visit) const {
+        // 3D DDA：按顺序访问射线在 [t0,t1] 内穿过的粗格，visit(进入t, 离开t, 上界) 返回true时停止
+        auto p = r.at(t0);
+        int cell[3], step[3];
+        double next[3], delta[3];
+        for (int a = 0; a < 3; a++) {
+            auto extent = voxel[a] * cell_size;
+            auto origin = bounds.axis_interval(a).min;
+            cell[a] = std::clamp(int(std::floor((p[a] - origin) / extent)), 0, cells[a] - 1);
+
+            auto d = r.direction()[a];
+            if (d > 0) {
+                step[a] = 1;
+                next[a] = t0 + (origin + (cell[a] + 1) * extent - p[a]) / d;
+                delta[a] = extent / d;
+            } else if (d < 0) {
+                step[a] = -1;
+                next[a] = t0 + (origin + cell[a] * extent - p[a]) / d;
+                delta[a] = -extent / d;
+            } else {
+                step[a] = 0;
+                next[a] = infinity;
+                delta[a] = infinity;
+            }
+        }
+
+        for (auto t = t0; t < t1;) {
+            int a = next[0] < next[1] ? (next[0] < next[2] ? 0 : 2) : (next[1] < next[2] ? 1 : 2);
+            auto exit = std::min(next[a], t1);
+            if (visit(t, exit, majorants[(size_t(cell[2]) * cells[1] + cell[1]) * cells[0] + cell[0]]))
+                return;
+
+            t = exit;
+            cell[a] += step[a];
+            if (cell[a] < 0 || cell[a] >= cells[a]) return;
+            next[a] += delta[a];
+        }
+    }
+
+    bool march_scatter(const ray& r, double t0, double t1, double& t) const {
+        // 定步长光线步进：取每步中点的密度累计光学厚度，超过随机目标值时在该步内线性插值出散射点
+        auto dt = march_step / r.direction().length();
+        auto target = -rtw_log(1 - random_double());
+        auto tau = 0.0;
+        for (auto ta = t0; ta < t1; ta += dt) {
+            auto tb = std::min(ta + dt, t1);
+            auto step_tau = density(r.at(0.5 * (ta + tb))) * (tb - ta) * r.direction().length();
+            if (tau + step_tau >= target) {
+                t = ta + (tb - ta) * (target - tau) / step_tau;
+                return true;
+            }
+            tau += step_tau;
+        }
+        return false;
+    }
+
+    double march_transmittance(const ray& r, double t0, double t1) const {
+        auto dt = march_step / r.direction().length();
+        auto tau = 0.0;
+        for (auto ta = t0; ta < t1; ta += dt) {
+            auto tb = std::min(ta + dt, t1);
+            tau += density(r.at(0.5 * (ta + tb))) * (tb - ta) * r.direction().length();
+        }
+        return rtw_exp(-tau);
+    }
+};
+
+class grid_volume : public hittable { // 网格介质的边界：包围盒的六个面（无材质），交点带有网格介质的标记
+public:
+    grid_volume(shared_ptr<medium> interior, const aabb& bounds)
+        : interior(interior),
+          boundary(box(point3(bounds.x.min, bounds.y.min, bounds.z.min), point3(bounds.x.max, bounds.y.max, bounds.z.max), nullptr))
+    {}
+
+    bool hit(const ray& r, interval ray_t, hit_record& rec) const override {
+        if (!boundary->hit(r, interval(std::max(ray_t.min, rec.boundaries_from), ray_t.max), rec))
+            return false;
+
+        rec.inside = interior.get(); // 与 constant_medium 相同，prim 仍是边界上的四边形
+        return true;
+    }
+
+    aabb bounding_box() const override { return boundary->bounding_box(); }
+
+private:
+    shared_ptr<medium> interior;        // 边界内的介质
+    shared_ptr<hittable_list> boundary; // 包围盒
+};
\ No newline at end of file
@@ -3,23 +3,154 @@
 #include "rtweekend.h"
 
 #include "AABB.h"
+#include "wide.h"
+
+#include <algorithm>
+#include <cstdint>
 
 class material; // 材质
+class hittable; // 可命中物体
+class medium;   // 参与介质
 
 class hit_record {  // 记录射线与物体的交点信息
 public:
+    // 遍历阶段只写入 t、prim、局部坐标(u,v)和 inside，其余字段由最近交点的 finalize_hit() 统一计算
     point3 p; // 交点坐标
     vec3 normal; //法线
-    shared_ptr<material> mat; // 材质
+    const material* mat; // 材质（由场景的 material_table 持有，这里只是裸指针，不做引用计数）
     double t; // 交点的t值 Ray的表示：P(t) = A + tb
-    double u, v; // 纹理坐标(u,v)
+    double u, v; // 纹理坐标(u,v)（对四边形来说就是平面坐标α、β）
+    double du = 0, dv = 0; // 像素足迹在纹理坐标上的宽度（用于选择MIP层级），0表示点采样
     bool front_face; // 是否是正面
+    bool enters_inside = false; // 沿射线方向穿过表面时进入 inside（否则离开）；通常等于 front_face，与朝向相反的边界重合时不同
+    const medium* inside = nullptr; // 表面内侧的介质（表面是介质边界，或与无材质的介质边界重合时非空）
+    double boundaries_from = -infinity; // 求交的输入：参数t小于它的介质边界不参与求交（见 camera::next_interaction）
+    const hittable* prim = nullptr; // 命中的图元（负责完成交点记录）
 
     void set_face_normal(const ray& r, const vec3& outward_normal) { // 设置面法线
         // 设置交点的法线和正面
         // NOTE: 参数 `outward_normal` 假定为单位长度。
         front_face = dot(r.direction(), outward_normal) < 0;
         normal = front_face ? outward_normal : -outward_normal;
+        enters_inside = front_face;
+    }
+};
+
+class ray_packet { // 相干射线包：相邻像素的相机射线，一起遍历BVH，每条射线各自记录最近交点
+public:
+    static const int max_size = 16;
+
+    int size = 0;                   // 射线数
+    ray rays[max_size];             // 射线
+    wide<max_size> t_max;           // 各射线当前最近交点的t（未命中为无穷大，空位为负无穷大）
+    hit_record recs[max_size];      // 各射线的最近交点（只在命中时写入，与 hittable::hit 相同）
+    uint32_t hits = 0;              // 已命中的射线（按位）
+
+    void add(const ray& r) {
+        rays[size] = r;
+        t_max[size] = infinity;
+        size++;
+    }
+
+    uint32_t all() const { return size >= 32 ? ~0u : (1u << size) - 1; } // 所有射线的掩码
+
+    void prepare() { // 射线加完后调用：按分量存下起点与方向倒数，并计算它们在整包上的区间，供区间算术剔除使用
+        hits = 0;
+        for (int k = 0; k < max_size; k++) { // 空位也参与逐路运算，填0并让 t_max 为负无穷大，结果总是未命中
+            origin.set(k, k < size ? rays[k].origin() : vec3());
+            inv_dir.set(k, k < size ? vec3(1, 1, 1) / rays[k].direction() : vec3());
+            if (k >= size) t_max[k] = -infinity;
+        }
+
+        coherent = size > 0;
+        for (int a = 0; a < 3 && coherent; a++) {
+            origin_lo[a] = inv_lo[a] = infinity;
+            origin_hi[a] = inv_hi[a] = -infinity;
+            for (int k = 0; k < size; k++) {
+                auto d = rays[k].direction()[a];
+                if (d == 0 || (d > 0) != (rays[0].direction()[a] > 0)) { coherent = false; break; } // 方向符号不一致时区间算术不成立
+                auto o = rays[k].origin()[a];
+                origin_lo[a] = std::min(origin_lo[a], o);
+                origin_hi[a] = std::max(origin_hi[a], o);
+                inv_lo[a] = std::min(inv_lo[a], 1 / d);
+                inv_hi[a] = std::max(inv_hi[a], 1 / d);
+            }
+        }
+    }
+
+    uint32_t cull(const aabb& box, uint32_t active, double t_min) const {
+        // 返回与box相交的活动射线：先用区间算术判断整包是否都错过（一次测试），
+        // 否则对所有射线逐路做板块测试（方向倒数已预先算好，与 aabb::hit 的判定相同）
+        if (coherent && interval_miss(box, active, t_min)) return 0;
+
+        return (size <= 8 ? slab_mask<8>(box, t_min) : slab_mask<max_size>(box, t_min)) & active;
+    }
+
+    inline void hit(const hittable& object, uint32_t active, double t_min); // 逐条求交（定义在 hittable 之后）
+
+    static int lowest(uint32_t mask) { // 最低的置位
+        int k = 0;
+        while (!(mask & 1)) { mask >>= 1; k++; }
+        return k;
+    }
+
+    static int count(uint32_t mask) { // 置位数
+        int n = 0;
+        for (; mask; mask &= mask - 1) n++;
+        return n;
+    }
+
+private:
+    bool coherent = false;  // 每个轴上所有方向同号（区间算术有效）
+    wide_vec3<max_size> origin, inv_dir; // 各射线的起点与方向倒数（按分量存储）
+    double origin_lo[3], origin_hi[3], inv_lo[3], inv_hi[3]; // 起点与方向倒数在每个轴上的区间
+
+    template <int lanes>
+    uint32_t slab_mask(const aabb& box, double t_min) const { // 前 lanes 路的板块测试：定长循环，所有路在一个循环里算完，编译器按路向量化
+        double plane_min[3], plane_max[3]; // 先取到局部变量，循环里不再读 box（否则无法向量化）
+        for (int a = 0; a < 3; a++) {
+            plane_min[a] = box.axis_interval(a).min;
+            plane_max[a] = box.axis_interval(a).max;
+        }
+
+        wide<lanes> lo, hi;
+        for (int k = 0; k < lanes; k++) {
+            auto l = t_min, h = t_max[k];
+            for (int a = 0; a < 3; a++) {
+                auto t0 = (plane_min[a] - origin[a][k]) * inv_dir[a][k];
+                auto t1 = (plane_max[a] - origin[a][k]) * inv_dir[a][k];
+                l = std::max(l, std::min(t0, t1));
+                h = std::min(h, std::max(t0, t1));
+            }
+            lo[k] = l;
+            hi[k] = h;
+        }
+        return less_mask(lo, hi);
+    }
+
+    bool interval_miss(const aabb& box, uint32_t active, double t_min) const {
+        // 区间算术：t = (平面 - 起点) * 方向倒数 在整包上的取值范围。所有射线进入时刻的下界大于离开时刻的上界时，整包都错过
+        auto t_far = -infinity;
+        for (auto m = active; m; m &= m - 1) t_far = std::max(t_far, t_max[lowest(m)]);
+
+        auto lo = t_min, hi = t_far;
+        for (int a = 0; a < 3; a++) {
+            const auto& ax = box.axis_interval(a);
+            bool positive = inv_lo[a] > 0;
+            auto near_plane = positive ? ax.min : ax.max;
+            auto far_plane = positive ? ax.max : ax.min;
+            lo = std::max(lo, product_min(near_plane - origin_hi[a], near_plane - origin_lo[a], inv_lo[a], inv_hi[a]));
+            hi = std::min(hi, product_max(far_plane - origin_hi[a], far_plane - origin_lo[a], inv_lo[a], inv_hi[a]));
+        }
+        return lo > hi;
+    }
+
+    static double product_min(double a0, double a1, double b0, double b1) {
+        return std::min(std::min(a0 * b0, a0 * b1), std::min(a1 * b0, a1 * b1));
+    }
+
+    static double product_max(double a0, double a1, double b0, double b1) {
+        return std::max(std::max(a0 * b0, a0 * b1), std::max(a1 * b0, a1 * b1));
     }
 };
 
@@ -27,11 +158,51 @@ class hittable {
 public:
     virtual ~hittable() = default;
 
-    virtual bool hit(const ray& r, interval ray_t, hit_record& rec) const = 0; // 判断射线是否与物体相交（相交是否有效,即含射线区间判断）
+    // 判断射线是否与物体相交（相交是否有效,即含射线区间判断）
+    // NOTE: 只在命中时写入 rec，并且只写 t、prim、局部坐标和内侧介质，着色数据留给 finalize_hit()
+    virtual bool hit(const ray& r, interval ray_t, hit_record& rec) const = 0;
+
+    // 为最近的交点补全 p、normal、front_face、uv 和材质。只会对 rec.prim 调用一次，
+    // 因此被淘汰的候选交点不再付出 atan2/acos、法线和材质引用计数的开销。
+    virtual void finalize_hit(const ray& r, hit_record& rec) const {}
 
     virtual aabb bounding_box() const = 0; // 返回物体的包围盒
+
+    virtual bool has_motion() const { return false; } // 物体（或其中的子物体）是否随射线时间运动；整个场景都静止时相机不采样时间
+
+    // 射线包求交：active 中的射线各自更新 packet 的最近交点。默认逐条调用 hit()，BVH 和物体列表会整包遍历
+    virtual void hit_packet(ray_packet& packet, uint32_t active, double t_min) const {
+        packet.hit(*this, active, t_min);
+    }
+
+    // 光源采样接口（只有可以作为光源的图元需要实现）
+    virtual double pdf_value(const point3& origin, const vec3& direction) const { // 用random()从origin采样到direction的概率密度（立体角）
+        return 0.0;
+    }
+
+    virtual vec3 random(const point3& origin) const { // 从origin出发朝物体上随机一点的方向（不要求单位长度）
+        return vec3(1, 0, 0);
+    }
+
+    virtual double emitted_power() const { // 作为光源时发出的总功率（亮度），供光源层次结构估计贡献；不发光的物体为0
+        return 0.0;
+    }
+
+    virtual bool emission_normal(vec3& normal) const { // 平面光源：写入其法线并返回true（两面都向各自一侧的半球发光）；其他物体按向所有方向发光处理
+        return false;
+    }
 };
 
+void ray_packet::hit(const hittable& object, uint32_t active, double t_min) {
+    for (; active; active &= active - 1) {
+        int k = lowest(active);
+        if (object.hit(rays[k], interval(t_min, t_max[k]), recs[k])) {
+            t_max[k] = recs[k].t;
+            hits |= 1u << k;
+        }
+    }
+}
+
 class translate : public hittable { // 平移物体
 public:
     translate(shared_ptr<hittable> object, const vec3& offset)
@@ -42,12 +213,17 @@ public:
 
     bool hit(const ray& r, interval ray_t, hit_record& rec) const override {
         // 将射线向后移动偏移量
-        ray offset_r(r.origin() - offset, r.direction(), r.time());
+        ray offset_r(r.origin() - offset, r.direction(), r.time(), r.spread(), r.width());
 
         // 确定偏移射线上是否存在交点（如果存在，交点在哪里）
         if (!object->hit(offset_r, ray_t, rec))
             return false;
 
+        // 实例内部的最近交点需要用对象空间的射线完成，所以在这里立即补全，
+        // 之后由实例自己作为 prim（其 finalize_hit 什么都不做）
+        rec.prim->finalize_hit(offset_r, rec);
+        rec.prim = this;
+
         // 将交叉点向前移动偏移量
         rec.p += offset;
 
@@ -56,6 +232,8 @@ public:
 
     aabb bounding_box() const override { return bbox; }
 
+    bool has_motion() const override { return object->has_motion(); }
+
 private:
     shared_ptr<hittable> object;
     vec3 offset;
@@ -109,12 +287,16 @@ public:
         direction[0] = cos_theta*r.direction()[0] - sin_theta*r.direction()[2];
         direction[2] = sin_theta*r.direction()[0] + cos_theta*r.direction()[2];
 
-        ray rotated_r(origin, direction, r.time());
+        ray rotated_r(origin, direction, r.time(), r.spread(), r.width());
 
         // 确定对象空间中是否存在交点（如果存在，交点在哪里）
         if (!object->hit(rotated_r, ray_t, rec))
             return false;
 
+        // 与 translate 相同，实例内部的最近交点在对象空间中立即补全
+        rec.prim->finalize_hit(rotated_r, rec);
+        rec.prim = this;
+
         // 将交点从对象空间移至世界空间
         auto p = rec.p;
         p[0] =  cos_theta*rec.p[0] + sin_theta*rec.p[2];
@@ -133,6 +315,8 @@ public:
 
     aabb bounding_box() const override { return bbox; }
 
+    bool has_motion() const override { return object->has_motion(); }
+
 private:
     shared_ptr<hittable> object;    // 物体
     double sin_theta;   // sin(θ)
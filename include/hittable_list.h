@@ -17,23 +17,48 @@ public:
     } 
 
     bool hit(const ray& r, interval ray_t, hit_record& rec) const override {  // 判断射线是否与物体相交
-        hit_record temp_rec;    // 临时记录
         bool hit_anything = false;  // 是否有物体被击中
         auto closest_so_far = ray_t.max; // Ray的最远有效t
 
         for (const auto& object : objects) { // 遍历所有物体，检查是否有物体被击中
-            if (object->hit(r, interval(ray_t.min, closest_so_far), temp_rec)) {
+            // hit() 只在命中更近交点时写入 rec，因此不需要临时记录和整条记录的拷贝
+            if (object->hit(r, interval(ray_t.min, closest_so_far), rec)) {
                 hit_anything = true;
-                closest_so_far = temp_rec.t;
-                rec = temp_rec;
+                closest_so_far = rec.t;
             }
         }
 
         return hit_anything;
     }
 
+    void hit_packet(ray_packet& packet, uint32_t active, double t_min) const override { // 整包依次与每个物体求交（物体是BVH时整包遍历）
+        for (const auto& object : objects)
+            object->hit_packet(packet, active, t_min);
+    }
+
     aabb bounding_box() const override { return bbox; } // 返回包围盒
 
+    bool has_motion() const override {
+        for (const auto& object : objects)
+            if (object->has_motion()) return true;
+        return false;
+    }
+
+    double pdf_value(const point3& origin, const vec3& direction) const override { // 各物体等概率选取，概率密度为平均值
+        auto weight = 1.0 / objects.size();
+        auto sum = 0.0;
+
+        for (const auto& object : objects)
+            sum += weight * object->pdf_value(origin, direction);
+
+        return sum;
+    }
+
+    vec3 random(const point3& origin) const override { // 随机选一个物体，再朝它采样
+        auto int_size = int(objects.size());
+        return objects[random_int(0, int_size-1)]->random(origin);
+    }
+
 private:
     aabb bbox;  // 包围盒
 };
\ No newline at end of file
@@ -0,0 +1,244 @@
+#pragma once
+
+#include "rtweekend.h"
+
+#include "AABB.h"
+#include "hittable.h"
+#include "hittable_list.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <cstdint>
+
+class light_bvh : public hittable {
+    // 光源层次结构：在发光图元上建一棵二叉树，每个结点记录包围盒、总功率和发光方向锥（平面光源的法线，见 hittable::emission_normal）。
+    // 采样时从根结点出发，按两个子结点对着色点的估计贡献随机选择一侧，O(log n) 选到一个光源，
+    // 因此大量光源中只有附近、明亮的光源会被频繁采样。
+public:
+    light_bvh(const hittable_list& list) { // 从物体列表中挑出发光的图元（emitted_power() > 0）建树
+        RTW_TRACE_ZONE_ARG("build", "light_bvh build", "objects", list.objects.size());
+        for (const auto& object : list.objects) {
+            auto power = object->emitted_power();
+            if (power > 0)
+                lights.push_back({object, object->bounding_box(), power, emitter_cone(*object), 0, 0});
+        }
+
+        if (lights.empty()) return;
+
+        std::vector<int> order(lights.size());
+        for (size_t i = 0; i < order.size(); i++) order[i] = int(i);
+        nodes.reserve(2 * lights.size());
+        build(order, 0, order.size(), 0, 0);
+        bbox = nodes[0].bbox;
+    }
+
+    size_t size() const { return lights.size(); } // 光源数
+
+    bool hit(const ray& r, interval ray_t, hit_record& rec) const override { // 求与最近光源的交点
+        bool hit_anything = false;
+        int stack[64];
+        int top = 0;
+        if (!nodes.empty()) stack[top++] = 0;
+
+        while (top > 0) {
+            const auto& nd = nodes[stack[--top]];
+            if (!nd.bbox.hit(r, ray_t)) continue;
+
+            if (nd.light >= 0) {
+                if (lights[nd.light].object->hit(r, ray_t, rec)) {
+                    hit_anything = true;
+                    ray_t.max = rec.t;
+                }
+            } else {
+                stack[top++] = nd.right;
+                stack[top++] = int(&nd - nodes.data()) + 1;
+            }
+        }
+
+        return hit_anything;
+    }
+
+    aabb bounding_box() const override { return bbox; }
+
+    double pdf_value(const point3& origin, const vec3& direction) const override {
+        // 与 random() 一致的概率密度：方向穿过的每个光源，其被选中的概率乘以该光源自身的方向概率密度，再求和。
+        // 只需沿射线遍历包围盒相交的结点，每个命中的光源再沿其路径从根结点算一次选择概率（O(log n)）。
+        auto sum = 0.0;
+        ray r(origin, direction);
+        int stack[64];
+        int top = 0;
+        if (!nodes.empty()) stack[top++] = 0;
+
+        while (top > 0) {
+            const auto& nd = nodes[stack[--top]];
+            if (!nd.bbox.hit(r, interval(0.001, infinity))) continue;
+
+            if (nd.light >= 0) {
+                auto light_pdf = lights[nd.light].object->pdf_value(origin, direction);
+                if (light_pdf > 0)
+                    sum += pmf(origin, lights[nd.light]) * light_pdf;
+            } else {
+                stack[top++] = nd.right;
+                stack[top++] = int(&nd - nodes.data()) + 1;
+            }
+        }
+
+        return sum;
+    }
+
+    vec3 random(const point3& origin) const override { // 按估计贡献从根结点走到一个光源，再朝该光源采样
+        if (nodes.empty()) return vec3(1, 0, 0);
+
+        int index = 0;
+        while (nodes[index].light < 0) {
+            int left = index + 1;
+            int right = nodes[index].right;
+            auto il = importance(origin, nodes[left]);
+            auto ir = importance(origin, nodes[right]);
+            if (il + ir <= 0) return vec3(1, 0, 0); // 该点看不到任何光源（pmf同样为0）
+
+            index = random_double() * (il + ir) < il ? left : right;
+        }
+
+        return lights[nodes[index].light].object->random(origin);
+    }
+
+private:
+    struct direction_cone {
+        // 发光方向锥：所有法线都在以axis为轴、半角θo的圆锥内，每个法线周围再向外扩展θe的方向上发光。
+        // two_sided 时法线也可能在反方向的圆锥内（两面发光的平面光源）
+        vec3 axis = vec3(0, 0, 1);
+        double cos_theta_o = -1;    // θo的余弦，-1表示整个球面
+        double cos_theta_e = 0;     // θe的余弦，漫反射光源为 π/2
+        bool two_sided = false;     // 法线锥同时包含 -axis 方向的圆锥
+
+        static direction_cone merge(const direction_cone& a, const direction_cone& b) { // 包住两个方向锥的方向锥（保守）
+            direction_cone c;
+            c.cos_theta_e = std::min(a.cos_theta_e, b.cos_theta_e);
+            if (a.cos_theta_o <= -1 || b.cos_theta_o <= -1) return c;
+
+            // 有一侧两面发光时结果也两面发光：b 的轴可以翻到与 a 同侧再合并（单面的圆锥包含在它与反向圆锥的并集里）
+            c.two_sided = a.two_sided || b.two_sided;
+            auto b_axis = c.two_sided && dot(a.axis, b.axis) < 0 ? -b.axis : b.axis;
+
+            auto mid = a.axis + b_axis;
+            if (mid.near_zero()) return c;
+            c.axis = unit_vector(mid);
+
+            auto theta_a = std::acos(std::clamp(dot(c.axis, a.axis), -1.0, 1.0)) + std::acos(a.cos_theta_o);
+            auto theta_b = std::acos(std::clamp(dot(c.axis, b_axis), -1.0, 1.0)) + std::acos(b.cos_theta_o);
+            auto theta = std::max(theta_a, theta_b);
+            c.cos_theta_o = theta >= pi ? -1 : std::cos(theta);
+            return c;
+        }
+    };
+
+    struct light_entry { // 一个光源
+        shared_ptr<hittable> object;    // 发光图元
+        aabb bbox;                      // 包围盒
+        double power;                   // 发光功率
+        direction_cone cone;            // 发光方向锥
+        uint64_t trail;                 // 从根结点到该光源叶结点的路径（第k位为1表示第k层走右子结点）
+        int depth;                      // 叶结点深度
+    };
+
+    struct node { // 树结点，左子结点紧跟在父结点之后
+        aabb bbox;              // 子树所有光源的包围盒
+        double power;           // 子树的总功率
+        direction_cone cone;    // 子树的发光方向锥
+        int right;              // 右子结点的下标（内部结点）
+        int light;              // 光源下标（叶结点），内部结点为-1
+    };
+
+    std::vector<light_entry> lights;    // 光源
+    std::vector<node> nodes;            // 树结点（深度优先顺序）
+    aabb bbox;                          // 所有光源的包围盒
+
+    int build(std::vector<int>& order, size_t start, size_t end, uint64_t trail, int depth) { // 按质心在最长轴上的中位数递归划分
+        int index = int(nodes.size());
+        nodes.push_back(node());
+
+        if (end - start == 1) {
+            auto& light = lights[order[start]];
+            light.trail = trail;
+            light.depth = depth;
+            nodes[index] = {light.bbox, light.power, light.cone, -1, order[start]};
+            return index;
+        }
+
+        aabb centroids = aabb::empty;
+        for (size_t i = start; i < end; i++) {
+            auto c = center(lights[order[i]].bbox);
+            centroids = aabb(centroids, aabb(c, c));
+        }
+        int axis = centroids.longest_axis();
+        auto mid = start + (end - start) / 2;
+        std::nth_element(order.begin() + start, order.begin() + mid, order.begin() + end, [&](int a, int b) {
+            return center(lights[a].bbox)[axis] < center(lights[b].bbox)[axis];
+        });
+
+        build(order, start, mid, trail, depth + 1);
+        int right = build(order, mid, end, trail | (uint64_t(1) << depth), depth + 1);
+
+        const auto& l = nodes[index + 1];
+        const auto& r = nodes[right];
+        nodes[index] = {aabb(l.bbox, r.bbox), l.power + r.power, direction_cone::merge(l.cone, r.cone), right, -1};
+        return index;
+    }
+
+    static direction_cone emitter_cone(const hittable& object) { // 平面光源：法线两侧各自向半球发光（θo=0，θe=π/2），其他为整个球面
+        direction_cone cone;
+        vec3 normal;
+        if (!object.emission_normal(normal)) return cone;
+        cone.axis = unit_vector(normal);
+        cone.cos_theta_o = 1;
+        cone.two_sided = true;
+        return cone;
+    }
+
+    static point3 center(const aabb& box) {
+        return point3(0.5*(box.x.min + box.x.max), 0.5*(box.y.min + box.y.max), 0.5*(box.z.min + box.z.max));
+    }
+
+    static double importance(const point3& p, const node& nd) {
+        // 结点对着色点p的估计贡献：功率 * cosθ' / 距离²。距离不小于包围盒半对角线，避免点靠近或位于包围盒内时权重发散；
+        // θ' 是p所在方向与方向锥之间的最小夹角（扣除包围盒对p所张的角；两面发光时取与两个圆锥中较近的一个），超出 θe 时贡献为0
+        auto c = center(nd.bbox);
+        auto diag = vec3(nd.bbox.x.size(), nd.bbox.y.size(), nd.bbox.z.size());
+        auto d2 = std::max((p - c).length_squared(), 0.25 * diag.length_squared());
+
+        if (nd.cone.cos_theta_o <= -1) // 向所有方向发光
+            return nd.power / d2;
+
+        auto to_p = p - c;
+        auto dist2 = to_p.length_squared();
+        auto r2 = 0.25 * diag.length_squared();
+        if (dist2 <= r2) return nd.power / d2; // p在包围球内，任何方向都可能
+
+        auto cos_w = dot(nd.cone.axis, to_p / std::sqrt(dist2));
+        auto theta_w = rtw_acos(std::clamp(nd.cone.two_sided ? std::fabs(cos_w) : cos_w, -1.0, 1.0));
+        auto theta_b = rtw_asin(std::sqrt(r2 / dist2));
+        auto theta = std::max(0.0, theta_w - rtw_acos(nd.cone.cos_theta_o) - theta_b);
+        auto cos_theta = rtw_cos(theta);
+        if (cos_theta <= nd.cone.cos_theta_e) return 0;
+
+        return nd.power * cos_theta / d2;
+    }
+
+    double pmf(const point3& p, const light_entry& light) const { // 从p出发 random() 选中该光源的概率
+        auto prob = 1.0;
+        int index = 0;
+        for (int level = 0; level < light.depth; level++) {
+            int left = index + 1;
+            int right = nodes[index].right;
+            auto il = importance(p, nodes[left]);
+            auto ir = importance(p, nodes[right]);
+            if (il + ir <= 0) return 0;
+
+            bool go_right = (light.trail >> level) & 1;
+            prob *= (go_right ? ir : il) / (il + ir);
+            index = go_right ? right : left;
+        }
+        return prob;
+    }
+};
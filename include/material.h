@@ -2,54 +2,91 @@
 
 #include "rtweekend.h"
 
+#include "arena.h"
+#include "hittable.h"
+#include "onb.h"
 #include "Texture.h"
 
-class hit_record; //记录射线与物体的交点信息
+class scatter_record { // 材质采样记录：采样得到的散射方向、该方向上的BSDF值及其概率密度
+public:
+    ray scattered;              // 采样得到的散射射线
+    color f;                    // 沿散射方向的BSDF值乘以|cosθ|（相位函数不含余弦项）；镜面时为直接的衰减
+    double pdf = 0;             // 散射方向在立体角上的概率密度（镜面时无意义）
+    bool is_specular = false;   // 采样来自delta分布（镜面反射、折射），不能与其他采样策略组合
+
+    color weight() const { return is_specular ? f : f / pdf; } // 路径吞吐量应乘的权重 f/pdf
+};
 
-class material { //材质
+class material { //材质。材质的种类是封闭的：基类保存类型标记，emitted()和scatter()用switch分派到具体材质，不经过虚函数表
 public:
-    virtual ~material() = default;
+    enum class kind : unsigned char { lambertian, metal, dielectric, diffuse_light, isotropic }; // 材质类型
+    static const int kind_count = 5; // 材质类型数（按类型分批着色时的桶数）
 
-    virtual color emitted(double u, double v, const point3& p) const { //为了不需要让所有非发光材料都实现emitted()，我让基类返回黑色：
-        return color(0, 0, 0);
-    }
+    kind type() const { return tag; }
 
-    virtual bool scatter(const ray& r_in, const hit_record& rec, color& attenuation, ray& scattered) const { //是否散射
-        return false;
-    }
+    color emitted(double u, double v, const point3& p) const; // 发光颜色，非发光材质返回黑色（定义在所有材质类之后）
+
+    // 以下定义在所有材质类之后
+    bool scatter(const ray& r_in, const hit_record& rec, scatter_record& srec) const; // 按材质的分布采样一个散射方向，不散射时返回false
+    color eval(const ray& r_in, const hit_record& rec, const vec3& direction) const;  // 沿给定方向的BSDF值乘以|cosθ|（镜面材质为0）
+    double pdf(const ray& r_in, const hit_record& rec, const vec3& direction) const;  // scatter()采样到给定方向的概率密度（镜面材质为0）
+
+protected:
+    explicit material(kind tag) : tag(tag) {}
+    ~material() = default; // 非虚析构：材质总是经 material_table 按具体类型创建
+
+private:
+    kind tag; // 材质类型
 };
 
 class lambertian : public material { //郎伯反射（漫反射）
 public:
-    lambertian(const color& albedo) : tex(make_shared<solid_color>(albedo)) {}
-    lambertian(shared_ptr<Texture> tex) : tex(tex) {}
-
-    bool scatter(const ray& r_in, const hit_record& rec, color& attenuation, ray& scattered) const override { //是否散射
-        auto scatter_direction = rec.normal + random_unit_vector(); //接触点的单位法向量+随机生成的单位向量生成一个散射向量 （即散射方向）
+    lambertian(const color& albedo) : material(kind::lambertian), tex(albedo) {}
+    lambertian(shared_ptr<Texture> tex) : material(kind::lambertian), tex(tex) {}
+
+    bool scatter(const ray& r_in, const hit_record& rec, scatter_record& srec) const { //在法线所在半球上按余弦分布采样
+        onb uvw(rec.normal);
+        auto local = random_cosine_direction();
+        auto cos_theta = local.z();
+        if (cos_theta <= 0) //落在切平面上的退化样本
+            return false;
+
+        auto scatter_direction = uvw.transform(local); //局部坐标系中的余弦分布方向变换到世界坐标系
+
+        srec.scattered = ray(rec.p, scatter_direction, r_in.time()); //生成一条射线
+        srec.f = tex.value(rec.u, rec.v, rec.p, rec.du, rec.dv) * (cos_theta / pi); // BSDF = albedo/π
+        srec.pdf = cos_theta / pi;
+        srec.is_specular = false;
+        return true;
+    }
 
-        if (scatter_direction.near_zero()) //如果生成的向量接近0向量
-            scatter_direction = rec.normal; //则将散射方向设置为法向量
+    color eval(const ray& r_in, const hit_record& rec, const vec3& direction) const {
+        auto cos_theta = dot(rec.normal, unit_vector(direction));
+        if (cos_theta <= 0) return color(0,0,0);
+        return tex.value(rec.u, rec.v, rec.p, rec.du, rec.dv) * (cos_theta / pi);
+    }
 
-        scattered = ray(rec.p, scatter_direction, r_in.time()); //生成一条射线
-        attenuation = tex->value(rec.u, rec.v, rec.p); // 反射1个单位光线后的衰减
-        return true;
+    double pdf(const ray& r_in, const hit_record& rec, const vec3& direction) const {
+        auto cos_theta = dot(rec.normal, unit_vector(direction));
+        return cos_theta <= 0 ? 0 : cos_theta / pi;
     }
 
 private:
-    shared_ptr<Texture> tex; //纹理
-    color albedo;// Albedo 参数控制着表面的基色
+    texture_ref tex; //纹理（恒定颜色时内联保存）
 };
 
 class metal : public material {
 public:
-    metal(const color& albedo, double fuzz) : albedo(albedo), fuzz(fuzz < 1 ? fuzz : 1) {}
+    metal(const color& albedo, double fuzz) : material(kind::metal), albedo(albedo), fuzz(fuzz < 1 ? fuzz : 1) {}
 
-    bool scatter(const ray& r_in, const hit_record& rec, color& attenuation, ray& scattered) const override { //是否散射
+    bool scatter(const ray& r_in, const hit_record& rec, scatter_record& srec) const { //镜面反射（模糊反射同样作为delta分布处理，没有解析的pdf）
         vec3 reflected = reflect(r_in.direction(), rec.normal); //反射方向
         reflected += fuzz * random_in_unit_sphere(); //反射方向+模糊度(模糊球的半径) * 单位球内随机生成的点
-        scattered = ray(rec.p, reflected, r_in.time()); //生成一条射线
-        attenuation = albedo;
-        return (dot(scattered.direction(), rec.normal) > 0); //如果反射光线与法向量的点积大于0，则返回true
+        srec.scattered = ray(rec.p, reflected, r_in.time(), r_in.spread(), r_in.footprint(rec.t)); //生成一条射线（镜面反射沿用入射光锥的扩散角，宽度从交点处的足迹开始）
+        srec.f = albedo;
+        srec.pdf = 0;
+        srec.is_specular = true;
+        return (dot(reflected, rec.normal) > 0); //如果反射光线与法向量的点积大于0，则返回true
     }
 
 private:
@@ -59,10 +96,9 @@ private:
 
 class dielectric : public material { //介质(有折射)
 public:
-    dielectric(double refraction_index) : refraction_index(refraction_index) {} 
+    dielectric(double refraction_index) : material(kind::dielectric), refraction_index(refraction_index) {} 
 
-    bool scatter(const ray& r_in, const hit_record& rec, color& attenuation, ray& scattered) const override { //是否折射
-        attenuation = color(1.0, 1.0, 1.0); //衰减
+    bool scatter(const ray& r_in, const hit_record& rec, scatter_record& srec) const { //按菲涅尔反射率随机选择反射或折射（delta分布）
         double ri = rec.front_face ? (1.0/refraction_index) : refraction_index; //折射率（看接触面是否是入射光接触的表面，来决定是否哪个介质为入射光线所在）
 
         vec3 unit_direction = unit_vector(r_in.direction()); //入射光线的单位向量
@@ -77,7 +113,10 @@ public:
         else
             direction = refract(unit_direction, rec.normal, ri); //折射方向
 
-        scattered = ray(rec.p, direction, r_in.time()); // 生成一条光线
+        srec.scattered = ray(rec.p, direction, r_in.time(), r_in.spread(), r_in.footprint(rec.t)); // 生成一条光线（沿用入射光锥的扩散角，宽度从交点处的足迹开始）
+        srec.f = color(1.0, 1.0, 1.0); //衰减
+        srec.pdf = 0;
+        srec.is_specular = true;
         return true;
     }
 
@@ -87,34 +126,96 @@ private:
         // 使用克里斯托夫·施利克近似公式
         auto r0 = (1 - refraction_index) / (1 + refraction_index);
         r0 = r0*r0;
-        return r0 + (1-r0)*pow((1 - cosine),5);
+        return r0 + (1-r0)*pow5(1 - cosine);
     }
 };
 
 class diffuse_light : public material { //漫反射光源
 public:
-    diffuse_light(shared_ptr<Texture> tex) : tex(tex) {}
-    diffuse_light(const color& emit) : tex(make_shared<solid_color>(emit)) {} // 光源的颜色
+    diffuse_light(shared_ptr<Texture> tex) : material(kind::diffuse_light), tex(tex) {}
+    diffuse_light(const color& emit) : material(kind::diffuse_light), tex(emit) {} // 光源的颜色
 
-    color emitted(double u, double v, const point3& p) const override { //根据纹理坐标和交点位置返回光源的颜色
-        return tex->value(u, v, p);
+    color emitted(double u, double v, const point3& p) const { //根据纹理坐标和交点位置返回光源的颜色
+        return tex.value(u, v, p, 0, 0);
     }
 
 private:
-    shared_ptr<Texture> tex; //纹理
+    texture_ref tex; //纹理（恒定颜色时内联保存）
 };
 
 class isotropic : public material { //各向同性 (各向同性的散射函数选择一个均匀的随机方向：)
 public:
-    isotropic(const color& albedo) : tex(make_shared<solid_color>(albedo)) {}
-    isotropic(shared_ptr<Texture> tex) : tex(tex) {}
-
-    bool scatter(const ray& r_in, const hit_record& rec, color& attenuation, ray& scattered) const override {
-        scattered = ray(rec.p, random_unit_vector(), r_in.time());  //生成一条射线
-        attenuation = tex->value(rec.u, rec.v, rec.p);  // 反射1个单位光线后的衰减
+    isotropic(const color& albedo) : material(kind::isotropic), tex(albedo) {}
+    isotropic(shared_ptr<Texture> tex) : material(kind::isotropic), tex(tex) {}
+
+    bool scatter(const ray& r_in, const hit_record& rec, scatter_record& srec) const { //在整个球面上均匀采样
+        srec.scattered = ray(rec.p, random_unit_vector(), r_in.time());  //生成一条射线
+        srec.f = tex.value(rec.u, rec.v, rec.p, rec.du, rec.dv) / (4*pi); // 相位函数 albedo/4π
+        srec.pdf = 1 / (4*pi);
+        srec.is_specular = false;
         return true;    //返回true
     }
 
+    color eval(const ray& r_in, const hit_record& rec, const vec3& direction) const {
+        return tex.value(rec.u, rec.v, rec.p, rec.du, rec.dv) / (4*pi);
+    }
+
+    double pdf(const ray& r_in, const hit_record& rec, const vec3& direction) const {
+        return 1 / (4*pi);
+    }
+
+private:
+    texture_ref tex; //纹理（恒定颜色时内联保存）
+};
+
+inline color material::emitted(double u, double v, const point3& p) const { // 只有光源发光
+    if (tag == kind::diffuse_light)
+        return static_cast<const diffuse_light*>(this)->emitted(u, v, p);
+    return color(0, 0, 0);
+}
+
+inline bool material::scatter(const ray& r_in, const hit_record& rec, scatter_record& srec) const { // 按类型标记分派
+    switch (tag) {
+        case kind::lambertian: return static_cast<const lambertian*>(this)->scatter(r_in, rec, srec);
+        case kind::metal:      return static_cast<const metal*>(this)->scatter(r_in, rec, srec);
+        case kind::dielectric: return static_cast<const dielectric*>(this)->scatter(r_in, rec, srec);
+        case kind::isotropic:  return static_cast<const isotropic*>(this)->scatter(r_in, rec, srec);
+        case kind::diffuse_light: return false; // 光源不散射
+    }
+    return false;
+}
+
+inline color material::eval(const ray& r_in, const hit_record& rec, const vec3& direction) const { // 只有非镜面材质有可求值的BSDF
+    switch (tag) {
+        case kind::lambertian: return static_cast<const lambertian*>(this)->eval(r_in, rec, direction);
+        case kind::isotropic:  return static_cast<const isotropic*>(this)->eval(r_in, rec, direction);
+        default:               return color(0, 0, 0);
+    }
+}
+
+inline double material::pdf(const ray& r_in, const hit_record& rec, const vec3& direction) const {
+    switch (tag) {
+        case kind::lambertian: return static_cast<const lambertian*>(this)->pdf(r_in, rec, direction);
+        case kind::isotropic:  return static_cast<const isotropic*>(this)->pdf(r_in, rec, direction);
+        default:               return 0;
+    }
+}
+
+class material_table { // 场景持有的材质表：图元和hit_record只保存裸指针，命中路径上不再有引用计数的原子操作
+public:
+    material_table(scene_arena* arena = nullptr) : arena(arena) {} // 给定 arena 时材质在场景内存池中连续分配
+
+    template <typename T, typename... Args>
+    const material* add(Args&&... args) { // 创建材质并返回其在表中的稳定地址
+        if (arena) materials.push_back(arena->make<T>(std::forward<Args>(args)...));
+        else materials.push_back(make_shared<T>(std::forward<Args>(args)...));
+        return materials.back().get();
+    }
+
+    size_t size() const { return materials.size(); }    // 材质数量
+    const material* operator[](size_t i) const { return materials[i].get(); } // 按索引取材质
+
 private:
-    shared_ptr<Texture> tex;
-};
\ No newline at end of file
+    scene_arena* arena; // 场景内存池（可为空）
+    std::vector<shared_ptr<material>> materials; // 材质表（只在构建场景时持有，扩容时地址不变）
+};
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "rtweekend.h"
+
+#include "hittable.h"
+#include "material.h"
+#include "Texture.h"
+
+class medium { // 参与介质：路径位于介质内部时，由积分器在每段射线上采样自由程，而不是由边界几何体在求交时采样
+public:
+    virtual ~medium() = default;
+
+    // 在射线参数区间 [0, t_max) 内采样下一次散射的位置。发生散射时写入 t 并返回 true；
+    // 散射事件的权重为1（反照率由相位函数给出），未散射时同样不改变路径吞吐量
+    virtual bool sample_scatter(const ray& r, double t_max, double& t) const = 0;
+
+    // 射线在参数区间 [t_min, t_max] 上的透射率（阴影射线使用，可以是无偏估计）
+    virtual double transmittance(const ray& r, double t_min, double t_max) const = 0;
+
+    void interaction(const ray& r, double t, hit_record& rec) const { // 用介质中的散射点填写交点记录
+        rec.t = t;
+        rec.p = r.at(t);
+        rec.normal = vec3(1,0,0);  // arbitrary
+        rec.front_face = true;     // also arbitrary
+        rec.u = rec.v = 0;
+        rec.du = rec.dv = 0;
+        rec.mat = &phase_function;
+        rec.inside = nullptr;
+        rec.prim = nullptr;
+    }
+
+protected:
+    medium(shared_ptr<Texture> tex) : phase_function(tex) {}
+    medium(const color& albedo) : phase_function(albedo) {}
+
+    isotropic phase_function; // 相位函数（各向同性）
+};
+
+class homogeneous_medium : public medium { // 均匀介质：消光系数处处相同，自由程按指数分布解析采样
+public:
+    homogeneous_medium(double density, shared_ptr<Texture> tex) : medium(tex), density(density) {}
+    homogeneous_medium(double density, const color& albedo) : medium(albedo), density(density) {}
+
+    bool sample_scatter(const ray& r, double t_max, double& t) const override {
+        auto ray_length = r.direction().length();
+        auto hit_distance = -rtw_log(random_double()) / density; // 自由程
+        t = hit_distance / ray_length;
+        return t < t_max;
+    }
+
+    double transmittance(const ray& r, double t_min, double t_max) const override { // Beer-Lambert
+        return rtw_exp(-density * (t_max - t_min) * r.direction().length());
+    }
+
+private:
+    double density; // 消光系数
+};
+
+class medium_stack { // 路径当前所处的介质（嵌套的介质边界按进入顺序入栈，栈顶为当前介质）
+public:
+    const medium* current() const { return count > 0 ? items[count-1] : nullptr; }
+
+    void enter(const medium* m) { // 进入介质（嵌套过深时忽略）
+        if (count < max_depth) items[count++] = m;
+    }
+
+    void exit(const medium* m) { // 离开介质：移除栈中最近进入的同一介质
+        for (int i = count - 1; i >= 0; i--)
+            if (items[i] == m) {
+                for (int j = i; j < count - 1; j++) items[j] = items[j+1];
+                count--;
+                return;
+            }
+    }
+
+    void cross(const hit_record& rec) { cross(rec.inside, rec.enters_inside); } // 穿过带介质标记的表面：从外侧穿入时进入，从内侧穿出时离开
+
+    void cross(const medium* m, bool entering) {
+        if (!m) return;
+        if (entering) enter(m);
+        else exit(m);
+    }
+
+private:
+    static const int max_depth = 8;  // 最大嵌套层数
+    const medium* items[max_depth];  // 介质栈
+    int count = 0;                   // 栈中的介质数
+};
@@ -0,0 +1,269 @@
+#pragma once
+
+#include "rtweekend.h"
+
+#include "rtw_stb_image.h"
+#include "texture_cache.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <string>
+
+class mipmap { // 分块存储的MIP金字塔：每层按 8x8 纹素块连续存放在磁盘文件中，查询时经 texture_cache 按需读入并做双线性/三线性过滤
+public:
+    static const int tile_size = texture_cache::tile_size;              // 块边长（纹素）
+    static const int texels_per_tile = tile_size * tile_size;           // 每块纹素数
+    static const int bytes_per_texel = texture_cache::bytes_per_texel;  // RGB各8位（线性值）
+
+    mipmap() {}
+
+    mipmap(const mipmap&) = delete; // 分块文件由一个对象独占（析构时关闭），只能移动
+    mipmap& operator=(const mipmap&) = delete;
+
+    mipmap(mipmap&& other) noexcept
+        : levels(std::move(other.levels)), file(other.file), resident(std::move(other.resident)) { other.file = -1; }
+
+    mipmap& operator=(mipmap&& other) noexcept {
+        if (this != &other) {
+            close();
+            levels = std::move(other.levels);
+            file = other.file;
+            resident = std::move(other.resident);
+            other.file = -1;
+        }
+        return *this;
+    }
+
+    ~mipmap() { close(); }
+
+    explicit mipmap(const char* image_filename) {
+        // 打开图像对应的分块文件：默认与图像同目录，扩展名追加 .tiles；定义了 RTW_TILE_CACHE 环境变量时放在该目录下。
+        // 文件不存在或已过期（源图像的大小或修改时间不同）时，解码图像、构建金字塔并写出分块文件；
+        // 写不出时（比如目录只读）金字塔留在内存中，查询时直接读取，不经过 texture_cache。
+        RTW_TRACE_ZONE("load", "mipmap open");
+        auto source = rtw_image::locate(image_filename);
+        if (source.empty()) {
+            std::cerr << "ERROR: Could not load image file '" << image_filename << "'.\n";
+            return;
+        }
+
+        auto stamp = source_stamp(source);
+        auto tiled = tiles_path(source);
+        if (open_tiled(tiled, stamp)) return;
+
+        rtw_image image(source.c_str());
+        if (image.width() <= 0 || image.height() <= 0) return;
+
+        std::vector<unsigned char> tiles;
+        build(image, tiles);
+
+        if (write_tiled(tiled, stamp, tiles) && open_tiled(tiled, stamp)) return;
+
+        std::clog << "Could not write texture tiles to '" << tiled << "', keeping the MIP pyramid in memory.\n";
+        resident = std::move(tiles);
+    }
+
+    bool empty() const { return levels.empty(); }
+    int level_count() const { return int(levels.size()); }
+    int width() const { return levels.empty() ? 0 : levels[0].width; }
+    int height() const { return levels.empty() ? 0 : levels[0].height; }
+
+    color lookup(double u, double v, double du, double dv) const {
+        // 三线性过滤查询。(u,v)为图像坐标（v向下），du、dv为像素足迹在纹理坐标上的宽度，
+        // 根据足迹覆盖的第0层纹素数选择层级；足迹为0时退化为第0层的双线性查询
+        auto lod = level_of_detail(du, dv);
+        auto top = level_count() - 1;
+
+        if (lod <= 0) return bilinear(0, u, v);
+        if (lod >= top) return bilinear(top, u, v);
+
+        int l0 = int(lod);
+        auto frac = lod - l0;
+        return (1 - frac) * bilinear(l0, u, v) + frac * bilinear(l0 + 1, u, v);
+    }
+
+    double level_of_detail(double du, double dv) const { // 足迹覆盖的第0层纹素数的log2（不足一个纹素时为0，即第0层）
+        auto footprint = std::max(du * levels[0].width, dv * levels[0].height);
+        return footprint > 1 ? std::log2(footprint) : 0.0;
+    }
+
+    color bilinear(int level, double u, double v) const { // 在指定层级上做双线性插值
+        const auto& lv = levels[level];
+        auto x = u * lv.width - 0.5;
+        auto y = v * lv.height - 0.5;
+        auto x0 = int(std::floor(x));
+        auto y0 = int(std::floor(y));
+        auto fx = x - x0;
+        auto fy = y - y0;
+
+        auto c00 = texel(lv, x0,     y0);
+        auto c10 = texel(lv, x0 + 1, y0);
+        auto c01 = texel(lv, x0,     y0 + 1);
+        auto c11 = texel(lv, x0 + 1, y0 + 1);
+
+        return (1 - fy) * ((1 - fx) * c00 + fx * c10)
+             +      fy  * ((1 - fx) * c01 + fx * c11);
+    }
+
+private:
+    static const uint32_t file_version = 2;  // 分块文件格式版本（2：文件头加入源图像的修改时间）
+
+    struct level { // 一层金字塔
+        int32_t width, height;  // 纹素尺寸
+        int32_t tiles_x;        // 每行的块数
+        int32_t reserved;       // 对齐填充（写入文件时保持确定内容）
+        uint64_t first_tile;    // 本层第一块在文件中的块序号
+    };
+
+    struct stamp { // 源图像的大小和修改时间，与分块文件头中记录的不同时分块文件已过期
+        uint64_t size;
+        int64_t mtime;  // 文件系统时钟的计数
+
+        bool operator==(const stamp& other) const { return size == other.size && mtime == other.mtime; }
+    };
+
+    std::vector<level> levels;              // 第0层为原始分辨率
+    int file = -1;                          // 分块文件在 texture_cache 中的编号
+    std::vector<unsigned char> resident;    // 分块文件写不出时，整个金字塔的分块数据（非空时不使用 file）
+
+    void close() { // 从 texture_cache 中关闭分块文件（连同常驻的块）
+        if (file >= 0) texture_cache::global().close(file);
+        file = -1;
+    }
+
+    static stamp source_stamp(const std::string& path) {
+        std::error_code ec;
+        auto size = std::filesystem::file_size(path, ec);
+        auto time = std::filesystem::last_write_time(path, ec);
+        return {ec ? 0 : uint64_t(size), ec ? 0 : int64_t(time.time_since_epoch().count())};
+    }
+
+    static std::string tiles_path(const std::string& source) {
+        auto dir = getenv("RTW_TILE_CACHE");
+        if (!dir) return source + ".tiles";
+        return (std::filesystem::path(dir) / std::filesystem::path(source).filename()).string() + ".tiles";
+    }
+
+    static uint64_t tile_count(int width, int height) {
+        return uint64_t((width + tile_size - 1) / tile_size) * ((height + tile_size - 1) / tile_size);
+    }
+
+    static size_t texel_offset(const level& lv, int x, int y) { // 纹素相对本层起点的字节偏移：块内行优先，块之间也行优先
+        auto tile = size_t(y / tile_size) * lv.tiles_x + (x / tile_size);
+        auto in_tile = (y % tile_size) * tile_size + (x % tile_size);
+        return (tile * texels_per_tile + in_tile) * bytes_per_texel;
+    }
+
+    void build(const rtw_image& image, std::vector<unsigned char>& tiles) {
+        // 构建整个金字塔的分块数据（仅在转换时整体驻留内存）
+        RTW_TRACE_ZONE("load", "mipmap build");
+        int w = image.width(), h = image.height();
+        uint64_t first = 0;
+        while (true) {
+            levels.push_back({w, h, (w + tile_size - 1) / tile_size, 0, first});
+            first += tile_count(w, h);
+            if (w == 1 && h == 1) break;
+            w = std::max(1, w / 2);
+            h = std::max(1, h / 2);
+        }
+        tiles.assign(first * texture_cache::tile_bytes, 0);
+
+        auto at = [&](const level& lv, int x, int y) {
+            return &tiles[lv.first_tile * texture_cache::tile_bytes + texel_offset(lv, x, y)];
+        };
+
+        // 第0层：把行优先的像素重新排列成块
+        for (int y = 0; y < levels[0].height; y++)
+            for (int x = 0; x < levels[0].width; x++) {
+                auto src = image.pixel_data(x, y);
+                auto dst = at(levels[0], x, y);
+                dst[0] = src[0]; dst[1] = src[1]; dst[2] = src[2];
+            }
+
+        // 逐层用2x2盒式滤波下采样，直到1x1
+        for (size_t l = 1; l < levels.size(); l++) {
+            const auto& prev = levels[l-1];
+            const auto& next = levels[l];
+            for (int y = 0; y < next.height; y++)
+                for (int x = 0; x < next.width; x++) {
+                    int sum[3] = {0, 0, 0};
+                    for (int dy = 0; dy < 2; dy++)
+                        for (int dx = 0; dx < 2; dx++) {
+                            auto src = at(prev, std::min(2*x + dx, prev.width - 1),
+                                                std::min(2*y + dy, prev.height - 1));
+                            for (int c = 0; c < 3; c++) sum[c] += src[c];
+                        }
+                    auto dst = at(next, x, y);
+                    for (int c = 0; c < 3; c++) dst[c] = static_cast<unsigned char>((sum[c] + 2) / 4);
+                }
+        }
+    }
+
+    bool write_tiled(const std::string& path, const stamp& source, const std::vector<unsigned char>& tiles) const {
+        // 写出分块文件：文件头（魔数、版本、源图像的大小和修改时间、层数、各层描述），随后是所有块。
+        // 写入失败时删除不完整的文件并返回false
+        auto f = std::fopen(path.c_str(), "wb");
+        if (!f) return false;
+
+        uint32_t version = file_version;
+        uint32_t count = uint32_t(levels.size());
+        std::fwrite("RTWT", 1, 4, f);
+        std::fwrite(&version, sizeof(version), 1, f);
+        std::fwrite(&source.size, sizeof(source.size), 1, f);
+        std::fwrite(&source.mtime, sizeof(source.mtime), 1, f);
+        std::fwrite(&count, sizeof(count), 1, f);
+        std::fwrite(levels.data(), sizeof(level), levels.size(), f);
+        std::fwrite(tiles.data(), 1, tiles.size(), f);
+        bool ok = !std::ferror(f);
+        ok = std::fclose(f) == 0 && ok;
+        if (!ok) std::remove(path.c_str());
+        return ok;
+    }
+
+    bool open_tiled(const std::string& path, const stamp& source) {
+        // 打开已有的分块文件，只读入文件头；源图像的大小或修改时间不符时视为过期
+        auto f = std::fopen(path.c_str(), "rb");
+        if (!f) return false;
+
+        char magic[4];
+        uint32_t version = 0, count = 0;
+        stamp recorded{};
+        bool ok = std::fread(magic, 1, 4, f) == 4 && std::string(magic, 4) == "RTWT"
+               && std::fread(&version, sizeof(version), 1, f) == 1 && version == file_version
+               && std::fread(&recorded.size, sizeof(recorded.size), 1, f) == 1
+               && std::fread(&recorded.mtime, sizeof(recorded.mtime), 1, f) == 1 && recorded == source
+               && std::fread(&count, sizeof(count), 1, f) == 1 && count > 0 && count < 64;
+        if (ok) {
+            levels.resize(count);
+            ok = std::fread(levels.data(), sizeof(level), count, f) == count;
+        }
+        if (!ok) {
+            levels.clear();
+            std::fclose(f);
+            return false;
+        }
+
+        file = texture_cache::global().open(f, uint64_t(std::ftell(f)));
+        return true;
+    }
+
+    color texel(const level& lv, int x, int y) const { // 取纹素（坐标钳制到边缘）并转换到[0,1]
+        x = x < 0 ? 0 : (x >= lv.width ? lv.width - 1 : x);
+        y = y < 0 ? 0 : (y >= lv.height ? lv.height - 1 : y);
+
+        auto offset = texel_offset(lv, x, y);
+        unsigned char p[3];
+        if (!resident.empty())
+            std::memcpy(p, &resident[lv.first_tile * texture_cache::tile_bytes + offset], 3);
+        else
+            texture_cache::global().texel(file, lv.first_tile + offset / texture_cache::tile_bytes,
+                                          int(offset % texture_cache::tile_bytes), p);
+
+        auto color_scale = 1.0 / 255.0;
+        return color(color_scale*p[0], color_scale*p[1], color_scale*p[2]);
+    }
+};
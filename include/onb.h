@@ -0,0 +1,24 @@
+#pragma once
+
+#include "rtweekend.h"
+
+class onb { // 标准正交基（orthonormal basis），w轴对齐给定的法向量，用于把局部坐标系中采样的方向变换到世界坐标系
+public:
+    onb(const vec3& n) {
+        axis[2] = unit_vector(n);
+        vec3 a = (std::fabs(axis[2].x()) > 0.9) ? vec3(0,1,0) : vec3(1,0,0); // 选一个与w不平行的辅助向量
+        axis[1] = unit_vector(cross(axis[2], a));
+        axis[0] = cross(axis[2], axis[1]);
+    }
+
+    const vec3& u() const { return axis[0]; }
+    const vec3& v() const { return axis[1]; }
+    const vec3& w() const { return axis[2]; }
+
+    vec3 transform(const vec3& v) const { // 把基坐标(a,b,c)变换为世界坐标 a*u + b*v + c*w
+        return (v[0] * axis[0]) + (v[1] * axis[1]) + (v[2] * axis[2]);
+    }
+
+private:
+    vec3 axis[3]; // u、v、w三个轴
+};
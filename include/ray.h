@@ -5,16 +5,19 @@
 class ray {
 public:
     ray() {}
-    ray(const point3& origin, const vec3& direction, double time = 0.0)
-        : orig(origin), dir(direction), tm(time) {}
-
-    ray(const point3& origin, const vec3& direction) 
-        : orig(origin), dir(direction) {}
+    ray(const point3& origin, const vec3& direction, double time = 0.0, double spread = 0.0, double width = 0.0)
+        : orig(origin), dir(direction), tm(time), spr(spread), wid(width) {}
 
     const point3& origin() const  { return orig; }
     const vec3& direction() const { return dir; }
 
     double time() const { return tm; } // 返回光线所在的时间
+    double spread() const { return spr; } // 返回光锥的扩散角（弧度），用于估计交点处的像素足迹
+    double width() const { return wid; }  // 返回光锥在起点处的宽度（镜面反射、折射之前累积下来的足迹）
+
+    double footprint(double t) const { // 光锥在 at(t) 处的宽度（像素足迹）
+        return wid + spr * t * dir.length();
+    }
 
     point3 at(double t) const { // Ray的表示：P(t) = A + tb，A是Ray的起点，b是Ray的方向，t是参数
         return orig + t*dir;
@@ -24,4 +27,6 @@ private:
     point3 orig; // Ray的起点
     vec3 dir;    // Ray的方向
     double tm;   // Ray的时间（光线自己所在的时刻）
+    double spr = 0; // 光锥扩散角：沿光线走过距离d时足迹宽度约为 wid+spr*d，两者都为0表示不做纹理过滤
+    double wid = 0; // 光锥在起点处的宽度：相机射线为0，镜面反射、折射后的射线从交点处的足迹继续扩展
 };
\ No newline at end of file
@@ -9,52 +9,87 @@
 #define STBI_FAILURE_USERMSG // 在stb_image库中，这个宏用于控制当图像加载失败时，错误消息的格式。如果定义了这个宏，stb_image库会在加载失败时，返回一个错误消息字符串，而不是直接退出程序。
 #include "stb_image/stb_image.h"
 
+#include "trace.h"
+
+#include <cmath>
+#include <cstdio>
 #include <cstdlib>
 #include <iostream>
+#include <string>
 
 class rtw_image {   // 读取图像文件
 public:
     rtw_image() {}
 
-    rtw_image(const char* image_filename) {
-        // 从指定文件加载图像数据。如果定义了 RTW_IMAGES 环境变量 则只在该目录下查找图像文件。如果未找到图像，则首先在当前目录下查找指定的图像文件，然后在 images/ 子目录下查找，接着在_parent_的 images/ 子目录下查找，然后在_that_ parent 目录下查找，依此类推，向上查找六层。如果图片加载不成功，width() 和 height() 将返回 0。
-
-        auto filename = std::string(image_filename);    // 图像文件名
-        auto imagedir = getenv("RTW_IMAGES");           // 图像目录
-
-        // 在一些可能的位置搜索图像文件。
-        if (imagedir && load(std::string(imagedir) + "/" + image_filename)) return;
-        if (load(filename)) return;
-        if (load("images/" + filename)) return;
-        if (load("../images/" + filename)) return;
-        if (load("../../images/" + filename)) return;
-        if (load("../../../images/" + filename)) return;
-        if (load("../../../../images/" + filename)) return;
-        if (load("../../../../../images/" + filename)) return;
-        if (load("../../../../../../images/" + filename)) return;
+    rtw_image(const char* image_filename, bool high_dynamic_range = false) {
+        // 从指定文件加载图像数据，查找规则见 locate()。如果图片加载不成功，width() 和 height() 将返回 0。
+        // high_dynamic_range 为 true 时保留浮点数据（HDR 文件的辐射亮度不截断到[0,1]），用 hdr_pixel() 读取。
+        RTW_TRACE_ZONE("load", "image decode");
+        auto path = locate(image_filename);
+        if (!path.empty() && (high_dynamic_range ? load_hdr(path) : load(path))) return;
 
         std::cerr << "ERROR: Could not load image file '" << image_filename << "'.\n";  // 输出错误信息
     }
 
+    rtw_image(const rtw_image&) = delete;
+    rtw_image& operator=(const rtw_image&) = delete;
+
     ~rtw_image() {  // 释放图像数据
-        delete[] bdata;
+        STBI_FREE(bdata);
         STBI_FREE(fdata);
     }
 
+    static std::string locate(const char* image_filename) {
+        // 返回图像文件的实际路径，找不到时返回空串。如果定义了 RTW_IMAGES 环境变量 则先在该目录下查找图像文件。然后在当前目录下查找指定的图像文件，然后在 images/ 子目录下查找，接着在_parent_的 images/ 子目录下查找，然后在_that_ parent 目录下查找，依此类推，向上查找六层。
+
+        auto filename = std::string(image_filename);    // 图像文件名
+        auto imagedir = getenv("RTW_IMAGES");           // 图像目录
+
+        std::string candidates[] = {
+            imagedir ? std::string(imagedir) + "/" + filename : std::string(),
+            filename,
+            "images/" + filename,
+            "../images/" + filename,
+            "../../images/" + filename,
+            "../../../images/" + filename,
+            "../../../../images/" + filename,
+            "../../../../../images/" + filename,
+            "../../../../../../images/" + filename,
+        };
+
+        // 在一些可能的位置搜索图像文件。
+        for (const auto& candidate : candidates) {
+            if (candidate.empty()) continue;
+            if (auto f = std::fopen(candidate.c_str(), "rb")) {
+                std::fclose(f);
+                return candidate;
+            }
+        }
+        return std::string();
+    }
+
     bool load(const std::string& filename) {
-        // 从给定的文件名加载线性（gamma=1）图像数据。如果加载成功，则返回 true。生成的数据缓冲区包含第一个像素的三个 [0.0, 1.0] 浮点数值（红色、绿色、蓝色）。像素是连续的，从左到右依次为图像的宽度，下一行为图像的高度。
+        // 从给定的文件名加载线性（gamma=1）的8位图像数据。如果加载成功，则返回 true。每个像素三个字节（红色、绿色、蓝色），像素是连续的，从左到右依次为图像的宽度，下一行为图像的高度。
+        // 直接解码成8位再查表线性化，与 stbi_loadf 后再转字节的结果一致，但不再需要每纹素12字节的浮点缓冲。
 
         auto n = bytes_per_pixel; // 虚拟输出参数：每个像素的原始分量
-        fdata = stbi_loadf(filename.c_str(), &image_width, &image_height, &n, bytes_per_pixel); // 加载图像数据
-        if (fdata == nullptr) return false;
+        bdata = stbi_load(filename.c_str(), &image_width, &image_height, &n, bytes_per_pixel); // 加载图像数据
+        if (bdata == nullptr) return false;
 
         bytes_per_scanline = image_width * bytes_per_pixel; // 每行的字节数
-        convert_to_bytes(); // 将浮点数据转换为字节数据
+        linearize_bytes(); // 将sRGB字节转换为线性字节
         return true;
     }
 
-    int width()  const { return (fdata == nullptr) ? 0 : image_width; } // 返回图像宽度
-    int height() const { return (fdata == nullptr) ? 0 : image_height; }// 返回图像高度
+    bool load_hdr(const std::string& filename) {
+        // 加载线性浮点RGB数据，每个像素三个float。HDR 文件原样读入；8位图像按 gamma 2.2 线性化。如果加载成功，则返回 true。
+        auto n = bytes_per_pixel;
+        fdata = stbi_loadf(filename.c_str(), &image_width, &image_height, &n, bytes_per_pixel);
+        return fdata != nullptr;
+    }
+
+    int width()  const { return (bdata == nullptr && fdata == nullptr) ? 0 : image_width; } // 返回图像宽度
+    int height() const { return (bdata == nullptr && fdata == nullptr) ? 0 : image_height; }// 返回图像高度
 
     const unsigned char* pixel_data(int x, int y) const {
         // 返回(x,y)处像素的三个 RGB 字节的地址。如果没有图像数据，则返回洋红色。
@@ -67,10 +102,21 @@ public:
         return bdata + y*bytes_per_scanline + x*bytes_per_pixel;
     }
 
+    const float* hdr_pixel(int x, int y) const {
+        // 返回(x,y)处像素的三个线性浮点分量的地址（以 high_dynamic_range 方式加载时）。没有数据时返回洋红色。
+        static float magenta[] = { 1, 0, 1 };
+        if (fdata == nullptr) return magenta;
+
+        x = clamp(x, 0, image_width);
+        y = clamp(y, 0, image_height);
+
+        return fdata + (size_t(y)*image_width + x)*bytes_per_pixel;
+    }
+
 private:
     const int      bytes_per_pixel = 3;     // 每个像素的原始字节数(RGB)
-    float         *fdata = nullptr;         // 线性浮点像素data
     unsigned char *bdata = nullptr;         // 线性8位像素数据
+    float         *fdata = nullptr;         // 线性浮点像素数据（HDR）
     int            image_width = 0;         // 已加载图像的宽度
     int            image_height = 0;        // 已加载图像的高度
     int            bytes_per_scanline = 0;  // 每行的字节数
@@ -87,16 +133,15 @@ private:
         return static_cast< unsigned char >(256.0 * value);
     }
 
-    void convert_to_bytes() {
-        // 将线性浮点像素数据转换为字节，并将转换后的字节数据存储在 `bdata` 成员中。
-        int total_bytes = image_width * image_height * bytes_per_pixel;
-        bdata = new unsigned char[total_bytes];
+    void linearize_bytes() {
+        // 原地把 sRGB（gamma 2.2）字节转换为线性字节。查找表与 stbi_loadf 的转换公式相同。
+        unsigned char table[256];
+        for (int i = 0; i < 256; i++)
+            table[i] = float_to_byte(float(std::pow(i / 255.0f, 2.2f)));
 
-        // 遍历所有像素分量，将 [0.0, 1.0] 浮点数值转换为 无符号 [0, 255] 字节值。
-        auto *bptr = bdata;
-        auto *fptr = fdata;
-        for (auto i=0; i < total_bytes; i++, fptr++, bptr++)
-            *bptr = float_to_byte(*fptr);
+        int total_bytes = image_width * image_height * bytes_per_pixel;
+        for (auto i=0; i < total_bytes; i++)
+            bdata[i] = table[bdata[i]];
     }
 };
 
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <cmath>
+#include <cstdint>
 #include <cstdlib>
 #include <iostream>
 #include <limits>
@@ -26,10 +27,53 @@ inline double degrees_to_radians(double degrees) {  // 角度转弧度
     return degrees * pi / 180.0;
 }
 
-inline double random_double() { // 生成[0,1)之间的随机数
+class sample_stream { // 样本流：在当前线程上激活后，random_double() 改为从它按维度取数（见 sampler.h）
+public:
+    virtual double next() = 0;                  // 当前维度的样本，维度加一
+    virtual void start_bounce(int bounce) = 0;  // 切换到第bounce次反弹的起始维度
+
+protected:
+    ~sample_stream() = default;
+};
+
+inline sample_stream*& active_sample_stream() { // 当前线程激活的样本流（为空时使用伪随机数）
+    static thread_local sample_stream* stream = nullptr;
+    return stream;
+}
+
+// 为 1 时BVH遍历、图元求交和路径追踪累加开销计数（camera::cost_heatmaps 的结点数、求交数、路径段数热力图）。
+// 为 0 时 count_cost() 是空的：每访问一个结点都要读一次线程局部变量，即使没有激活计数也会慢2%~3%
+#ifndef RTW_COST_COUNTERS
+#define RTW_COST_COUNTERS 0
+#endif
+
+class cost_counters { // 渲染开销计数：在当前线程上激活后，BVH遍历、图元求交和路径追踪把各自的次数累加到这里（见 cost_heatmap.h）
+public:
+    uint64_t bvh_nodes = 0;         // 访问的BVH结点数（包含阴影射线）
+    uint64_t primitive_tests = 0;   // 图元求交次数（包含阴影射线）
+    uint64_t path_segments = 0;     // 追踪的路径段数（相机射线和每次反弹各一段）
+};
+
+inline cost_counters*& active_cost_counters() { // 当前线程激活的开销计数（为空时不计数）
+    static thread_local cost_counters* counters = nullptr;
+    return counters;
+}
+
+inline void count_cost(uint64_t cost_counters::* field) { // 当前线程激活的开销计数中 field 一项加一
+#if RTW_COST_COUNTERS
+    if (auto counters = active_cost_counters()) (counters->*field)++;
+#endif
+}
+
+inline double random_uniform() { // 生成[0,1)之间的伪随机数（不经过样本流）
     return rand() / (RAND_MAX + 1.0);
 }
 
+inline double random_double() { // 生成[0,1)之间的随机数
+    if (auto stream = active_sample_stream()) return stream->next();
+    return random_uniform();
+}
+
 inline double random_double(double min, double max) { // 生成[min,max)之间的随机数
     return min + (max-min)*random_double();
 }
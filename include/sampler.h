@@ -0,0 +1,176 @@
+#pragma once
+
+#include "rtweekend.h"
+
+#include <algorithm>
+#include <cstdint>
+
+class sampler : public sample_stream {
+    // 像素采样器：为每个像素样本按维度提供样本值。维度的分配是固定的——前 camera_dimensions 维给相机
+    // （像素内位置、镜头、时间），之后每次反弹占 bounce_dimensions 维，按取数的先后顺序使用；超出的维度退回伪随机数。
+    // 激活后 random_double() 从这里取数（见 rtweekend.h），材质、光源和介质的采样代码不需要改动。
+    //   sobol       Owen 扰乱的 Sobol (0,2) 序列：每两维一组，样本序号按(像素,维度组)打乱后取二维 Sobol 点，不同组之间互不相关
+    //   halton      二维 Halton 序列（底2和3）：每两维一组，样本序号按维度组打乱，每个像素每一维做一次随机平移
+    //   blue_noise  蓝噪声抖动：所有像素使用同一个 Sobol 序列，按蓝噪声掩码做平移，误差在屏幕空间呈高频分布
+    //   independent 独立的伪随机数
+public:
+    enum class kind { independent, halton, sobol, blue_noise };
+
+    static const int camera_dimensions = 6; // 像素内位置(2)、镜头(2)、时间(1)，补齐到偶数使每段都从新的维度组开始
+    static const int bounce_dimensions = 8; // 每次反弹可用的维度数
+
+    sampler(kind type = kind::sobol, int samples_per_pixel = 1)
+        : type(type), spp(uint32_t(samples_per_pixel > 0 ? samples_per_pixel : 1)) {}
+
+    void start_pixel_sample(int i, int j, int index) { // 开始像素(i,j)的第index个样本，从相机维度开始
+        px = uint32_t(i);
+        py = uint32_t(j);
+        sample = uint32_t(index);
+        dim = 0;
+        end = camera_dimensions;
+    }
+
+    void start_bounce(int bounce) override {
+        dim = camera_dimensions + bounce * bounce_dimensions;
+        end = dim + bounce_dimensions;
+    }
+
+    double next() override {
+        if (dim >= end) return random_uniform();
+        return get(dim++);
+    }
+
+private:
+    kind type;              // 采样器类型
+    uint32_t spp;           // 每个像素的样本数
+    uint32_t px = 0, py = 0;// 当前像素
+    uint32_t sample = 0;    // 当前样本序号
+    int dim = 0;            // 当前维度
+    int end = 0;            // 本段（相机或当前反弹）可用维度的上界
+    uint32_t pair_seed = 0; // 当前维度组（偶数维取数时算出）的种子
+    uint32_t pair_index = 0;// 当前维度组打乱后的样本序号
+
+    double get(int d) {
+        switch (type) {
+            case kind::sobol:      return sobol_sample(d);
+            case kind::halton:     return halton_sample(d);
+            case kind::blue_noise: return blue_noise_sample(d);
+            default:               return random_uniform();
+        }
+    }
+
+    double sobol_sample(int d) {
+        if (!(d & 1)) { // 同一组的两维使用相同的序号，保持二维分层；维度按顺序取用，序号在组的第一维算一次即可
+            pair_seed = hash(px, py, uint32_t(d >> 1));
+            pair_index = permutation_element(sample, spp, pair_seed);
+        }
+        auto v = (d & 1) ? sobol_1(pair_index) : reverse_bits(pair_index);
+        return to_unit(owen_scramble(v, mix(pair_seed + uint32_t(d & 1))));
+    }
+
+    double halton_sample(int d) const {
+        // 大素数为底的维度在样本数少时分布很差，所以每两维一组都用底2和3，样本序号按维度组打乱
+        auto index = permutation_element(sample, spp, mix(uint32_t(d >> 1) + 0x68e31da4));
+        auto x = radical_inverse((d & 1) ? 3 : 2, index) + to_unit(hash(px, py, uint32_t(d)));
+        return x < 1 ? x : x - 1; // Cranley-Patterson 平移
+    }
+
+    double blue_noise_sample(int d) const {
+        const auto& mask = blue_noise_mask();
+        auto h = mix(uint32_t(d) + 0x2c1b3c6d); // 每一维使用掩码的不同平移，避免维度之间相关
+        auto x = (px + (h & 63)) & 63;
+        auto y = (py + ((h >> 8) & 63)) & 63;
+
+        auto index = permutation_element(sample, spp, mix(uint32_t(d >> 1) + 0x297a2d39));
+        auto v = to_unit((d & 1) ? sobol_1(index) : reverse_bits(index)) + mask[y * 64 + x];
+        return v < 1 ? v : v - 1;
+    }
+
+    static double to_unit(uint32_t v) { return v * 0x1p-32; }
+
+    static uint32_t reverse_bits(uint32_t v) {
+        v = (v << 16) | (v >> 16);
+        v = ((v & 0x00ff00ff) << 8) | ((v & 0xff00ff00) >> 8);
+        v = ((v & 0x0f0f0f0f) << 4) | ((v & 0xf0f0f0f0) >> 4);
+        v = ((v & 0x33333333) << 2) | ((v & 0xcccccccc) >> 2);
+        v = ((v & 0x55555555) << 1) | ((v & 0xaaaaaaaa) >> 1);
+        return v;
+    }
+
+    static uint32_t sobol_1(uint32_t i) { // Sobol 序列的第二维（第一维就是按位反转的 van der Corput 序列）
+        uint32_t r = 0;
+        for (uint32_t v = 1u << 31; i; i >>= 1, v ^= v >> 1)
+            if (i & 1) r ^= v;
+        return r;
+    }
+
+    static uint32_t owen_scramble(uint32_t v, uint32_t seed) { // 基于哈希的嵌套均匀扰乱（Laine-Karras 置换）
+        v = reverse_bits(v);
+        v ^= v * 0x3d20adea;
+        v += seed;
+        v *= (seed >> 16) | 1;
+        v ^= v * 0x05526c56;
+        v ^= v * 0x53a22864;
+        return reverse_bits(v);
+    }
+
+    static uint32_t permutation_element(uint32_t i, uint32_t n, uint32_t seed) { // [0,n) 上由seed确定的随机置换的第i个元素（Kensler）
+        uint32_t w = n - 1;
+        w |= w >> 1; w |= w >> 2; w |= w >> 4; w |= w >> 8; w |= w >> 16;
+        do {
+            i ^= seed; i *= 0xe170893d; i ^= seed >> 16; i ^= (i & w) >> 4;
+            i ^= seed >> 8; i *= 0x0929eb3f; i ^= seed >> 23; i ^= (i & w) >> 1;
+            i *= 1 | seed >> 27; i *= 0x6935fa69; i ^= (i & w) >> 11; i *= 0x74dcb303;
+            i ^= (i & w) >> 2; i *= 0x9e501cc3; i ^= (i & w) >> 2; i *= 0xc860a3df;
+            i &= w; i ^= i >> 5;
+        } while (i >= n);
+        return (i + seed) % n;
+    }
+
+    static double radical_inverse(int base, uint32_t i) { // 把i的base进制数字镜像到小数点后
+        auto inv_base = 1.0 / base, f = inv_base;
+        double r = 0;
+        for (; i; i /= base, f *= inv_base)
+            r += (i % base) * f;
+        return r;
+    }
+
+    static uint32_t mix(uint32_t x) { // 32位整数哈希
+        x ^= x >> 16; x *= 0x7feb352d;
+        x ^= x >> 15; x *= 0x846ca68b;
+        x ^= x >> 16;
+        return x;
+    }
+
+    static uint32_t hash(uint32_t a, uint32_t b, uint32_t c) { return mix(a ^ mix(b ^ mix(c + 0x9e3779b9))); }
+
+    static const std::vector<float>& blue_noise_mask() {
+        // 64x64 蓝噪声掩码（首次使用时生成）：依次把点放进当前“能量”最低（离已放置的点最远）的位置，
+        // 能量是已放置点的环绕高斯核之和；放置顺序归一化后就是掩码值，任意阈值下的点集都均匀而无聚团
+        static const std::vector<float> mask = [] {
+            const int n = 64, count = n * n;
+            double kernel[n][n];
+            for (int dy = 0; dy < n; dy++)
+                for (int dx = 0; dx < n; dx++) {
+                    auto x = std::min(dx, n - dx), y = std::min(dy, n - dy);
+                    kernel[dy][dx] = std::exp(-(x*x + y*y) / (2 * 1.5 * 1.5));
+                }
+
+            std::vector<double> energy(count, 0.0);
+            std::vector<float> values(count, -1.0f);
+            for (int rank = 0; rank < count; rank++) {
+                int best = -1;
+                for (int p = 0; p < count; p++)
+                    if (values[p] < 0 && (best < 0 || energy[p] < energy[best])) best = p;
+
+                values[best] = float((rank + 0.5) / count);
+                int bx = best % n, by = best / n;
+                for (int y = 0; y < n; y++)
+                    for (int x = 0; x < n; x++)
+                        energy[y * n + x] += kernel[(y - by) & (n - 1)][(x - bx) & (n - 1)];
+            }
+            return values;
+        }();
+        return mask;
+    }
+};
\ No newline at end of file
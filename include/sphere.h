@@ -1,11 +1,13 @@
 #pragma once
 
 #include "hittable.h"
+#include "material.h"
+#include "onb.h"
 
 class sphere : public hittable {    // 球体类
 public:
     // 静止球体
-    sphere(const point3& center, double radius, shared_ptr<material> mat)
+    sphere(const point3& center, double radius, const material* mat)
         : center1(center), radius(fmax(0,radius)), mat(mat), is_moving(false)
     {
         auto rvec = vec3(radius, radius, radius);    // 三个坐标方向上的半径向量
@@ -13,7 +15,7 @@ public:
     }
 
     // 运动球体
-    sphere(const point3& center1, const point3& center2, double radius, shared_ptr<material> mat)
+    sphere(const point3& center1, const point3& center2, double radius, const material* mat)
         : center1(center1), radius(fmax(0,radius)), mat(mat), is_moving(true)
     {   
         // 计算包围盒
@@ -26,6 +28,7 @@ public:
     }
 
     bool hit(const ray& r, interval ray_t, hit_record& rec) const override {  //判断射线是否与球体相交
+        count_cost(&cost_counters::primitive_tests);
         // t^2d \cdot d - 2td \cdot (C-Q)+(C-Q)\cdot(C-Q)-r^2=0
         // 圆心C，半径r，射线起点Q，射线方向d，t为未知数(射线与球体的交点)
         // 简化 -2h=b=-2d\cdot(C-Q)
@@ -50,22 +53,68 @@ public:
                 return false;
         }
 
-        // 记录交点信息
+        // 记录交点信息（着色数据延迟到 finalize_hit）
         rec.t = root;
+        rec.prim = this;
+        rec.inside = nullptr; // 普通表面，外层的 constant_medium 会改写为自己的介质
+
+        return true;
+    }
+
+    void finalize_hit(const ray& r, hit_record& rec) const override { // 为最近交点补全着色数据
+        point3 center = is_moving ? sphere_center(r.time()) : center1;
         rec.p = r.at(rec.t);
         vec3 outward_normal = (rec.p - center) / radius;
         rec.set_face_normal(r, outward_normal);
         get_sphere_uv(outward_normal, rec.u, rec.v); // 记录交点的纹理坐标
         rec.mat = mat;
 
-        return true;
+        // 像素足迹：u方向绕一圈长2πr，v方向从南极到北极长πr
+        auto footprint = r.footprint(rec.t);
+        rec.du = footprint / (2*pi*radius);
+        rec.dv = footprint / (pi*radius);
     }
 
     aabb bounding_box() const override { return bbox; } // 返回包围盒
+
+    bool has_motion() const override { return is_moving; }
+
+    double pdf_value(const point3& origin, const vec3& direction) const override {
+        // 在球对origin所张的立体角（圆锥）内均匀采样。只适用于静止球体；origin在球内时退化为整个球面上的均匀采样
+        hit_record rec;
+        if (!this->hit(ray(origin, direction), interval(0.001, infinity), rec))
+            return 0;
+
+        auto dist_squared = (center1 - origin).length_squared();
+        if (dist_squared <= radius*radius)
+            return 1 / (4*pi);
+
+        auto cos_theta_max = std::sqrt(1 - radius*radius/dist_squared);
+        auto solid_angle = 2*pi*(1-cos_theta_max);
+
+        return 1 / solid_angle;
+    }
+
+    double emitted_power() const override { // 漫反射面光源的功率 = π * 辐射亮度 * 面积（取球心处的发光值）
+        if (!mat) return 0.0;
+        auto radiance = luminance(mat->emitted(0.5, 0.5, center1));
+        return radiance > 0 ? pi * radiance * 4*pi*radius*radius : 0.0;
+    }
+
+    vec3 random(const point3& origin) const override { // 在球所张的圆锥内均匀采样一个方向
+        vec3 direction = center1 - origin;
+        auto distance_squared = direction.length_squared();
+        if (distance_squared <= radius*radius)
+            return random_unit_vector();
+
+        onb uvw(direction);
+        return uvw.transform(random_to_sphere(radius, distance_squared));
+    }
+
 private:
     point3 center1;  // 球心坐标
     double radius;  // 半径
-    shared_ptr<material> mat; // 材质
+    const material* mat; // 材质
     bool is_moving; // 是否是运动球体
     vec3 center_vec; // 球心运动方向
     aabb bbox; // 包围盒
@@ -75,6 +124,19 @@ private:
         return center1 + time*center_vec;
     }
 
+    static vec3 random_to_sphere(double radius, double distance_squared) { // 以z轴为中心、半角为θmax的圆锥内均匀分布的方向
+        auto r1 = random_double();
+        auto r2 = random_double();
+        auto z = 1 + r2*(std::sqrt(1-radius*radius/distance_squared) - 1);
+
+        double s, c;
+        rtw_sincos(2*pi*r1, s, c);
+        auto x = c * std::sqrt(1-z*z);
+        auto y = s * std::sqrt(1-z*z);
+
+        return vec3(x, y, z);
+    }
+
     static void get_sphere_uv(const point3& p, double& u, double& v) { // 获取球体的纹理坐标(其实就是计算球坐标系中的球面坐标的经纬度)
         // p: 以原点为中心、半径为 1 的球面上的给定点。
         // u: 返回 u 坐标 [0,1] of point on sphere.
@@ -83,8 +145,8 @@ private:
         //     <0 1 0> yields <0.50 1.00>       < 0 -1  0> yields <0.50 0.00>
         //     <0 0 1> yields <0.25 0.50>       < 0  0 -1> yields <0.75 0.50>
 
-        auto theta = acos(-p.y());
-        auto phi = atan2(-p.z(), p.x()) + pi;
+        auto theta = rtw_acos(-p.y());
+        auto phi = rtw_atan2(-p.z(), p.x()) + pi;
 
         u = phi / (2*pi);
         v = theta / pi;
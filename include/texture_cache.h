@@ -0,0 +1,189 @@
+#pragma once
+
+#include "rtweekend.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+class texture_cache { // 纹理块缓存：按需从分块文件中读入纹素块，常驻块数有上限（LRU淘汰），所有线程共享
+public:
+    static const int tile_size = 8;                                 // 块边长（纹素）
+    static const int bytes_per_texel = 3;                           // RGB各8位（线性值）
+    static const int tile_bytes = tile_size * tile_size * bytes_per_texel; // 每块192字节，正好3条缓存行
+
+    explicit texture_cache(size_t capacity_bytes)
+        : capacity_tiles(std::max<size_t>(1, capacity_bytes / tile_bytes)) {}
+
+    ~texture_cache() {
+        for (auto& f : files)
+            std::fclose(f.second.file);
+    }
+
+    static texture_cache& global() { // 全局共享的缓存，容量可由 RTW_TEXTURE_CACHE_MB 环境变量指定（默认64MB）
+        static texture_cache cache(default_capacity());
+        return cache;
+    }
+
+    int open(std::FILE* file, uint64_t data_offset) {
+        // 登记一个已打开的分块文件，返回其编号；缓存接管文件的关闭。
+        // 编号在整个进程内（所有缓存实例之间）不重复使用：线程私有缓存按编号记录块，关闭后其中残留的旧块不会被新文件查到
+        std::lock_guard<std::mutex> lock(mutex);
+        auto id = next_file_id()++;
+        files[id] = {file, data_offset};
+        return id;
+    }
+
+    void close(int file) { // 关闭编号为file的文件，并释放它在共享LRU中常驻的块
+        std::lock_guard<std::mutex> lock(mutex);
+        auto f = files.find(file);
+        if (f == files.end()) return;
+        std::fclose(f->second.file);
+        files.erase(f);
+
+        for (auto it = lru.begin(); it != lru.end();) {
+            if (int(it->first >> 40) != file) { ++it; continue; }
+            free_slots.push_back(it->second);
+            index.erase(it->first);
+            it = lru.erase(it);
+        }
+    }
+
+    void texel(int file, size_t tile, int offset, unsigned char out[3]) {
+        // 取出编号为file的文件中第tile块、块内偏移offset字节处的纹素。
+        // 先查线程私有的直接映射小缓存（无锁），未命中再查共享LRU，最后才读文件。
+        auto key = (uint64_t(file) << 40) | tile;
+        auto& local = local_cache();
+        auto& entry = local.entries[(key ^ (key >> 7)) % local_entries];
+
+        if (entry.key != key) {
+            fetch(key, entry.data, local);
+            entry.key = key;
+        } else {
+            local.hits++;
+        }
+
+        std::memcpy(out, entry.data + offset, 3);
+    }
+
+    // 统计信息（会先合并调用线程尚未提交的计数）
+    void report(std::ostream& out) {
+        std::lock_guard<std::mutex> lock(mutex);
+        flush(local_cache());
+        auto lookups = hits + misses;
+        out << "Texture cache: " << lookups << " tile lookups, "
+            << (lookups ? 100.0 * hits / lookups : 0.0) << "% hit rate, "
+            << misses << " tiles read, "
+            << lru.size() * tile_bytes / 1024.0 << " KB resident (limit "
+            << capacity_tiles * tile_bytes / 1024.0 << " KB)\n";
+    }
+
+    uint64_t lookup_count() {
+        std::lock_guard<std::mutex> lock(mutex);
+        flush(local_cache());
+        return hits + misses;
+    }
+
+private:
+    static const int local_entries = 64; // 每个线程私有缓存的块数（12KB，常驻L1/L2）
+
+    struct open_file {
+        std::FILE* file;    // 分块文件
+        uint64_t data_offset; // 第一块在文件中的偏移
+    };
+
+    struct local_state { // 线程私有的直接映射缓存与计数
+        struct slot {
+            uint64_t key = ~uint64_t(0);
+            unsigned char data[tile_bytes];
+        } entries[local_entries];
+        uint64_t hits = 0;      // 尚未提交的命中次数
+    };
+
+    size_t capacity_tiles;                          // 最多常驻的块数
+    std::mutex mutex;                               // 保护以下所有成员
+    std::unordered_map<int, open_file> files;       // 已登记的分块文件（按编号）
+    std::vector<unsigned char> storage;             // 常驻块的存储（按槽位连续存放）
+    std::vector<size_t> free_slots;                 // 关闭文件后空出的槽位
+    std::list<std::pair<uint64_t, size_t>> lru;     // (键, 槽位)，表头为最近使用
+    std::unordered_map<uint64_t, std::list<std::pair<uint64_t, size_t>>::iterator> index; // 键到LRU结点
+    uint64_t hits = 0;      // 命中次数（线程私有缓存与共享缓存）
+    uint64_t misses = 0;    // 从文件读入的块数
+
+    static size_t default_capacity() {
+        auto mb = getenv("RTW_TEXTURE_CACHE_MB");
+        return size_t(mb ? atoi(mb) : 64) << 20;
+    }
+
+    static void seek(std::FILE* file, uint64_t offset) { // 支持超过2GB的文件
+#ifdef _MSC_VER
+        _fseeki64(file, int64_t(offset), SEEK_SET);
+#else
+        fseeko(file, off_t(offset), SEEK_SET);
+#endif
+    }
+
+    static std::atomic<int>& next_file_id() { // 下一个文件编号（进程内所有缓存实例共用，编号占键的高24位）
+        static std::atomic<int> id{0};
+        return id;
+    }
+
+    static local_state& local_cache() {
+        thread_local local_state state;
+        return state;
+    }
+
+    void flush(local_state& local) { // 把线程私有计数并入共享计数（调用者持有锁）
+        hits += local.hits;
+        local.hits = 0;
+    }
+
+    void fetch(uint64_t key, unsigned char* dst, local_state& local) { // 从共享LRU取块，未命中时从文件读入
+        std::lock_guard<std::mutex> lock(mutex);
+        flush(local);
+
+        auto it = index.find(key);
+        if (it != index.end()) {
+            hits++;
+            lru.splice(lru.begin(), lru, it->second); // 移到表头
+            std::memcpy(dst, &storage[it->second->second * tile_bytes], tile_bytes);
+            return;
+        }
+
+        misses++;
+        auto f = files.find(int(key >> 40));
+        if (f == files.end()) { // 文件已关闭（不应再查询）
+            std::memset(dst, 0, tile_bytes);
+            return;
+        }
+
+        size_t slot;
+        if (!free_slots.empty()) { // 关闭文件空出的槽位
+            slot = free_slots.back();
+            free_slots.pop_back();
+        } else if (storage.size() / tile_bytes < capacity_tiles) { // 还有空槽位
+            if (storage.empty()) storage.reserve(capacity_tiles * tile_bytes); // 一次预留，避免扩容时超过上限
+            slot = storage.size() / tile_bytes;
+            storage.resize((slot + 1) * tile_bytes);
+        } else { // 淘汰最久未使用的块
+            slot = lru.back().second;
+            index.erase(lru.back().first);
+            lru.pop_back();
+        }
+
+        auto tile = key & ((uint64_t(1) << 40) - 1);
+        auto data = &storage[slot * tile_bytes];
+        seek(f->second.file, f->second.data_offset + tile * tile_bytes);
+        if (std::fread(data, 1, tile_bytes, f->second.file) != size_t(tile_bytes))
+            std::memset(data, 0, tile_bytes);
+
+        lru.emplace_front(key, slot);
+        index[key] = lru.begin();
+        std::memcpy(dst, data, tile_bytes);
+    }
+};
@@ -0,0 +1,145 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// 为 1 时记录时间线：RTW_TRACE_ZONE 标出的作用域（BVH构建、逐行/逐批渲染、降噪的各个工作线程、图像编码等）
+// 写入各线程自己的环形缓冲，渲染结束时导出为 Chrome trace_event 格式的 trace.json（可在 Perfetto 或 chrome://tracing 中打开）。
+// 为 0 时这些宏展开为空，参数也不求值
+#ifndef RTW_TRACE
+#define RTW_TRACE 0
+#endif
+
+#if RTW_TRACE
+
+class trace_log { // 时间线：每个线程一个环形缓冲，只有第一次记录时登记缓冲需要加锁
+public:
+    class event { // 一个作用域（名字和参数名必须是字符串常量，只保存指针）
+    public:
+        const char* category;
+        const char* name;
+        const char* arg_name;   // 为空表示没有参数
+        int64_t arg;
+        uint64_t start_ns, end_ns;  // 相对于 trace_log 创建时刻
+    };
+
+    class buffer { // 一个线程的环形缓冲：按需增长到 capacity 条，之后覆盖最早的事件
+    public:
+        static const size_t capacity = 1 << 16;
+
+        int tid;
+        const char* thread_name = "thread"; // 显示为 "名字 tid"
+        std::vector<event> events;
+        size_t next = 0;        // 已满时下一条覆盖的位置（即最早的事件）
+        uint64_t dropped = 0;   // 被覆盖的事件数
+
+        void push(const event& e) {
+            if (events.size() < capacity) {
+                events.push_back(e);
+                return;
+            }
+            events[next] = e;
+            next = (next + 1) % capacity;
+            dropped++;
+        }
+    };
+
+    static trace_log& global() {
+        static trace_log log;
+        return log;
+    }
+
+    uint64_t now_ns() const {
+        return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count());
+    }
+
+    buffer& thread_buffer() { // 当前线程的缓冲（线程结束后仍然保留到导出）
+        static thread_local buffer* local = nullptr;
+        if (!local) {
+            std::lock_guard<std::mutex> lock(mutex);
+            buffers.push_back(std::make_unique<buffer>());
+            local = buffers.back().get();
+            local->tid = int(buffers.size());
+        }
+        return *local;
+    }
+
+    void write_chrome_json(std::ostream& out) {
+        // Chrome trace_event 格式：每个作用域是一个完整事件（"ph":"X"），时间以微秒为单位；线程名用元数据事件给出。
+        // 导出时其他线程不应再记录（渲染结束后工作线程都已结束）
+        std::lock_guard<std::mutex> lock(mutex);
+        out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+        bool first = true;
+        auto separator = [&] { out << (first ? "" : ",\n"); first = false; };
+        uint64_t dropped = 0;
+        for (const auto& b : buffers) {
+            dropped += b->dropped;
+            separator();
+            out << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":" << b->tid
+                << ",\"args\":{\"name\":\"" << b->thread_name << ' ' << b->tid << "\"}}";
+            for (size_t k = 0; k < b->events.size(); k++) { // 从最早的事件开始
+                const auto& e = b->events[(b->next + k) % b->events.size()];
+                separator();
+                out << "{\"ph\":\"X\",\"cat\":\"" << e.category << "\",\"name\":\"" << e.name << "\",\"pid\":1,\"tid\":" << b->tid
+                    << ",\"ts\":" << e.start_ns / 1000 << '.' << digits3(e.start_ns % 1000)
+                    << ",\"dur\":" << (e.end_ns - e.start_ns) / 1000 << '.' << digits3((e.end_ns - e.start_ns) % 1000);
+                if (e.arg_name) out << ",\"args\":{\"" << e.arg_name << "\":" << e.arg << '}';
+                out << '}';
+            }
+        }
+        out << "\n],\"otherData\":{\"dropped_events\":" << dropped << "}}\n";
+    }
+
+private:
+    std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+    std::mutex mutex;
+    std::vector<std::unique_ptr<buffer>> buffers;
+
+    static std::string digits3(uint64_t v) { // 三位小数（纳秒部分）
+        return std::string(1, char('0' + v / 100)) + char('0' + v / 10 % 10) + char('0' + v % 10);
+    }
+};
+
+class trace_zone { // 作用域：析构时把从构造到析构的这段时间记入当前线程的缓冲；name 为空时不记录（按条件只记录一部分作用域）
+public:
+    trace_zone(const char* category, const char* name, const char* arg_name = nullptr, int64_t arg = 0)
+        : e{category, name, arg_name, arg, name ? trace_log::global().now_ns() : 0, 0} {}
+
+    ~trace_zone() {
+        if (!e.name) return;
+        auto& log = trace_log::global();
+        e.end_ns = log.now_ns();
+        log.thread_buffer().push(e);
+    }
+
+private:
+    trace_log::event e;
+};
+
+inline void trace_write(const std::string& filename, std::ostream& log) { // 导出到 filename
+    std::ofstream out(filename);
+    trace_log::global().write_chrome_json(out);
+    log << "Trace written to " << filename << '\n';
+}
+
+#define RTW_TRACE_CONCAT2(a, b) a##b
+#define RTW_TRACE_CONCAT(a, b) RTW_TRACE_CONCAT2(a, b)
+#define RTW_TRACE_ZONE(category, name) trace_zone RTW_TRACE_CONCAT(trace_zone_, __LINE__)(category, name)
+#define RTW_TRACE_ZONE_ARG(category, name, arg_name, arg) trace_zone RTW_TRACE_CONCAT(trace_zone_, __LINE__)(category, name, arg_name, int64_t(arg))
+#define RTW_TRACE_THREAD_NAME(name) (trace_log::global().thread_buffer().thread_name = (name))
+#define RTW_TRACE_WRITE(filename, log) trace_write(filename, log)
+
+#else
+
+#define RTW_TRACE_ZONE(category, name) ((void)0)
+#define RTW_TRACE_ZONE_ARG(category, name, arg_name, arg) ((void)0)
+#define RTW_TRACE_THREAD_NAME(name) ((void)0)
+#define RTW_TRACE_WRITE(filename, log) ((void)0)
+
+#endif
\ No newline at end of file
@@ -1,11 +1,43 @@
 #pragma once
 
+#include "fast_math.h"
+
+// 为 1 时 vec3 补齐为4个double（第4个分量恒为0），逐分量运算用 AVX（编译器开启AVX时，256位）或 SSE2（两组128位）指令；
+// 为 0 时是三个double的标量实现。两种实现的运算顺序相同，结果逐位一致。
+// 默认关闭：单个运算快慢互有，但 vec3 从24字节变成32字节，交点记录、射线和各种缓冲都变大，整帧反而更慢；
+// 真正按路并行的是射线包等按分量存储的数据（见 wide.h）
+#ifndef RTW_SIMD
+#define RTW_SIMD 0
+#endif
+
+#if RTW_SIMD && defined(__AVX__)
+#define RTW_SIMD_AVX 1
+#include <immintrin.h>
+#elif RTW_SIMD && (defined(__SSE2__) || defined(_M_X64))
+#define RTW_SIMD_SSE2 1
+#include <emmintrin.h>
+#endif
+
 class vec3 {
 public:
+#if RTW_SIMD_AVX
+    union { double e[4]; __m256d v; };
+#elif RTW_SIMD_SSE2
+    union { double e[4]; __m128d v[2]; };
+#else
     double e[3];
-
+#endif
+
+#if RTW_SIMD_AVX
+    vec3() : v(_mm256_setzero_pd()) {}
+    vec3(double e0, double e1, double e2) : v(_mm256_set_pd(0, e2, e1, e0)) {}
+#elif RTW_SIMD_SSE2
+    vec3() : v{_mm_setzero_pd(), _mm_setzero_pd()} {}
+    vec3(double e0, double e1, double e2) : v{_mm_set_pd(e1, e0), _mm_set_sd(e2)} {}
+#else
     vec3() : e{0,0,0} {}
     vec3(double e0, double e1, double e2) : e{e0, e1, e2} {}
+#endif
 
 	// 返回x,y,z三个方向的值
     double x() const { return e[0]; }
@@ -13,27 +45,25 @@ public:
     double z() const { return e[2]; }
 
 	// 重载操作以适应vec3
-    vec3 operator-() const { return vec3(-e[0], -e[1], -e[2]); }
     double operator[](int i) const { return e[i]; }
     double& operator[](int i) { return e[i]; }
 
-    vec3& operator+=(const vec3& v) {
-        e[0] += v.e[0];
-        e[1] += v.e[1];
-        e[2] += v.e[2];
-        return *this;
-    }
+#if RTW_SIMD_AVX
+    __m256d m() const { return v; }
+    explicit vec3(__m256d m) : v(m) {}
+#elif RTW_SIMD_SSE2
+    __m128d xy() const { return v[0]; }     // 前两个分量
+    __m128d zw() const { return v[1]; }     // 第三个分量和补齐的0
+    vec3(__m128d xy, __m128d zw) : v{xy, zw} {}
+#endif
 
-    vec3& operator*=(double t) {
-        e[0] *= t;
-        e[1] *= t;
-        e[2] *= t;
-        return *this;
-    }
+    vec3 operator-() const;
+    vec3& operator+=(const vec3& v);
+    vec3& operator*=(double t);
 
     vec3& operator/=(double t) { return *this *= 1/t; }
     double length() const { return sqrt(length_squared()); }
-    double length_squared() const { return e[0]*e[0] + e[1]*e[1] + e[2]*e[2]; }
+    double length_squared() const;
     bool near_zero() const { // 判断向量是否接近0向量
         const auto s = 1e-8;
         return (fabs(e[0]) < s) && (fabs(e[1]) < s) && (fabs(e[2]) < s);
@@ -49,17 +79,75 @@ using point3 = vec3;
 // Vector Utility Functions
 
 inline std::ostream& operator<<(std::ostream& out, const vec3& v) { return out << v.e[0] << ' ' << v.e[1] << ' ' << v.e[2]; }
+
+#if RTW_SIMD_AVX
+inline vec3 operator+(const vec3& u, const vec3& v) { return vec3(_mm256_add_pd(u.m(), v.m())); }
+inline vec3 operator-(const vec3& u, const vec3& v) { return vec3(_mm256_sub_pd(u.m(), v.m())); }
+inline vec3 operator*(const vec3& u, const vec3& v) { return vec3(_mm256_mul_pd(u.m(), v.m())); }
+inline vec3 operator*(double t, const vec3& v) { return vec3(_mm256_mul_pd(_mm256_set1_pd(t), v.m())); }
+inline vec3 operator/(const vec3& u, const vec3& v) { // 补齐分量按 0/1 计算，保持为0
+    return vec3(_mm256_div_pd(u.m(), _mm256_blend_pd(v.m(), _mm256_set1_pd(1.0), 0x8)));
+}
+inline double dot(const vec3& u, const vec3& v) { // 点乘（按 (x+y)+z 的顺序求和，与标量实现一致）
+    auto p = _mm256_mul_pd(u.m(), v.m());
+    auto xy = _mm256_castpd256_pd128(p);
+    auto zw = _mm256_extractf128_pd(p, 1);
+    return _mm_cvtsd_f64(_mm_add_sd(_mm_add_sd(xy, _mm_unpackhi_pd(xy, xy)), zw));
+}
+inline vec3 vec3::operator-() const { return vec3(_mm256_xor_pd(m(), _mm256_set1_pd(-0.0))); } // 翻转符号位（0 - x 会把 0 变成 +0）
+inline vec3& vec3::operator+=(const vec3& u) { v = _mm256_add_pd(v, u.v); return *this; }
+inline vec3& vec3::operator*=(double t) { v = _mm256_mul_pd(v, _mm256_set1_pd(t)); return *this; }
+#elif RTW_SIMD_SSE2
+inline vec3 operator+(const vec3& u, const vec3& v) { return vec3(_mm_add_pd(u.xy(), v.xy()), _mm_add_pd(u.zw(), v.zw())); }
+inline vec3 operator-(const vec3& u, const vec3& v) { return vec3(_mm_sub_pd(u.xy(), v.xy()), _mm_sub_pd(u.zw(), v.zw())); }
+inline vec3 operator*(const vec3& u, const vec3& v) { return vec3(_mm_mul_pd(u.xy(), v.xy()), _mm_mul_pd(u.zw(), v.zw())); }
+inline vec3 operator*(double t, const vec3& v) {
+    auto s = _mm_set1_pd(t);
+    return vec3(_mm_mul_pd(s, v.xy()), _mm_mul_pd(s, v.zw()));
+}
+inline vec3 operator/(const vec3& u, const vec3& v) { // 补齐分量按 0/1 计算，保持为0
+    return vec3(_mm_div_pd(u.xy(), v.xy()), _mm_div_sd(u.zw(), v.zw()));
+}
+inline double dot(const vec3& u, const vec3& v) { // 点乘（按 (x+y)+z 的顺序求和，与标量实现一致）
+    auto xy = _mm_mul_pd(u.xy(), v.xy());
+    auto z = _mm_mul_sd(u.zw(), v.zw());
+    return _mm_cvtsd_f64(_mm_add_sd(_mm_add_sd(xy, _mm_unpackhi_pd(xy, xy)), z));
+}
+inline vec3 vec3::operator-() const { // 翻转符号位（0 - x 会把 0 变成 +0）
+    auto sign = _mm_set1_pd(-0.0);
+    return vec3(_mm_xor_pd(xy(), sign), _mm_xor_pd(zw(), sign));
+}
+inline vec3& vec3::operator+=(const vec3& v) { *this = *this + v; return *this; }
+inline vec3& vec3::operator*=(double t) { *this = t * *this; return *this; }
+#else
 inline vec3 operator+(const vec3& u, const vec3& v) { return vec3(u.e[0] + v.e[0], u.e[1] + v.e[1], u.e[2] + v.e[2]); }
 inline vec3 operator-(const vec3& u, const vec3& v) { return vec3(u.e[0] - v.e[0], u.e[1] - v.e[1], u.e[2] - v.e[2]); }
 inline vec3 operator*(const vec3& u, const vec3& v) { return vec3(u.e[0] * v.e[0], u.e[1] * v.e[1], u.e[2] * v.e[2]); }
 inline vec3 operator*(double t, const vec3& v) { return vec3(t*v.e[0], t*v.e[1], t*v.e[2]); }
-inline vec3 operator*(const vec3& v, double t) { return t * v; }
-inline vec3 operator/(const vec3& v, double t) { return (1/t) * v; }
+inline vec3 operator/(const vec3& u, const vec3& v) { return vec3(u.e[0] / v.e[0], u.e[1] / v.e[1], u.e[2] / v.e[2]); }
 inline double dot(const vec3& u, const vec3& v) { // 点乘
     return u.e[0] * v.e[0]
          + u.e[1] * v.e[1]
          + u.e[2] * v.e[2];
 }
+inline vec3 vec3::operator-() const { return vec3(-e[0], -e[1], -e[2]); }
+inline vec3& vec3::operator+=(const vec3& v) {
+    e[0] += v.e[0];
+    e[1] += v.e[1];
+    e[2] += v.e[2];
+    return *this;
+}
+inline vec3& vec3::operator*=(double t) {
+    e[0] *= t;
+    e[1] *= t;
+    e[2] *= t;
+    return *this;
+}
+#endif
+
+inline vec3 operator*(const vec3& v, double t) { return t * v; }
+inline vec3 operator/(const vec3& v, double t) { return (1/t) * v; }
+inline double vec3::length_squared() const { return dot(*this, *this); }
 inline vec3 cross(const vec3& u, const vec3& v) { // 叉乘
     return vec3(u.e[1] * v.e[2] - u.e[2] * v.e[1],
                 u.e[2] * v.e[0] - u.e[0] * v.e[2],
@@ -67,29 +155,44 @@ inline vec3 cross(const vec3& u, const vec3& v) { // 叉乘
 }
 inline vec3 unit_vector(const vec3& v) { return v / v.length(); } // 返回一个单位向量
 
-inline vec3 random_in_unit_disk() { // 在单位圆盘内随机生成一个点用于光圈模糊
-    while (true) {
-        auto p = vec3(random_double(-1,1), random_double(-1,1), 0);
-        if (p.length_squared() < 1)
-            return p;
-    }
+inline vec3 random_in_unit_disk() { // 在单位圆盘内随机生成一个点用于光圈模糊（极坐标映射，恰好消耗两维样本）
+    auto r = std::sqrt(random_double());
+    double s, c;
+    rtw_sincos(2*pi*random_double(), s, c);
+    return vec3(r*c, r*s, 0);
 }
 
-inline vec3 random_in_unit_sphere() { // 在单位球内随机生成一个点用于漫反射, 只要点在圆内即可
-    while (true) {
-        auto p = vec3::random(-1,1);
-        if (p.length_squared() < 1)
-            return p;
-    }
+inline vec3 random_unit_vector() { // 随机生成一个单位向量（球面上均匀分布，直接映射，恰好消耗两维样本）
+    auto z = 1 - 2*random_double();
+    auto r = std::sqrt(fmax(0.0, 1 - z*z));
+    double s, c;
+    rtw_sincos(2*pi*random_double(), s, c);
+    return vec3(r*c, r*s, z);
 }
 
-inline vec3 random_unit_vector() { return unit_vector(random_in_unit_sphere()); } // 随机生成一个单位向量
+inline vec3 random_in_unit_sphere() { // 在单位球内均匀随机生成一个点（半径取 ξ 的立方根再乘均匀方向，直接映射，恰好消耗三维样本，不再拒绝采样）
+    auto r = std::cbrt(random_double());
+    return r * random_unit_vector();
+}
 
 inline vec3 random_on_hemisphere(const vec3& normal) { // 使得生成的反射光线在反射表面法相的半球内
     vec3 on_unit_sphere = random_unit_vector();
     return dot(on_unit_sphere, normal) > 0.0 ? on_unit_sphere : -on_unit_sphere; // In the same hemisphere as the normal
 }
 
+inline vec3 random_cosine_direction() { // 在以z轴为法向的半球上按余弦分布随机生成一个单位方向（概率密度为 cosθ/π）
+    auto r1 = random_double();
+    auto r2 = random_double();
+
+    double s, c;
+    rtw_sincos(2*pi*r1, s, c);
+    auto x = c * std::sqrt(r2);
+    auto y = s * std::sqrt(r2);
+    auto z = std::sqrt(1 - r2);
+
+    return vec3(x, y, z);
+}
+
 inline vec3 reflect(const vec3& v, const vec3& n) { // 反射
     return v - 2*dot(v,n)*n; // dot(v,n)是v在n上的投影，2*dot(v,n)*n是v在n上的投影的两倍，v减去这个投影的两倍就是反射后的向量
 }
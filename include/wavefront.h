@@ -0,0 +1,272 @@
+#pragma once
+
+#include "rtweekend.h"
+
+#include "denoiser.h"
+#include "hittable.h"
+#include "medium.h"
+#include "sampler.h"
+#include "trace.h"
+#include "wide.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+class ray_queue {
+    // 射线队列：每 lanes 条射线一块，块内起点、方向、时间、光锥的扩散角和宽度各分量按路连续存储（wide，见 wide.h），
+    // 逐块的定长循环（ray_sorter 计算排序键）由编译器按路向量化；每条射线记下所属路径的下标
+public:
+    static const int lanes = 8;
+
+    class block { // lanes 条射线
+    public:
+        wide_vec3<lanes> origin;    // 起点
+        wide_vec3<lanes> direction; // 方向
+        wide<lanes> time;           // 时间
+        wide<lanes> spread;         // 光锥扩散角
+        wide<lanes> width;          // 光锥在起点处的宽度
+    };
+
+    std::vector<block> blocks;      // 射线（最后一块的空位是该块第一条射线的副本，逐块运算时不必区分）
+    std::vector<int> path;          // 所属路径
+
+    size_t size() const { return path.size(); }
+    bool empty() const { return path.empty(); }
+
+    void clear() {
+        blocks.clear();
+        path.clear();
+    }
+
+    void reserve(size_t n) {
+        blocks.reserve((n + lanes - 1) / lanes);
+        path.reserve(n);
+    }
+
+    void push(const ray& r, int path_index) {
+        auto k = int(path.size() % lanes);
+        if (k == 0) { // 新的一块：所有路先填上这条射线
+            blocks.emplace_back();
+            for (int l = 0; l < lanes; l++) set(blocks.back(), l, r);
+        }
+        else set(blocks.back(), k, r);
+        path.push_back(path_index);
+    }
+
+    ray get(size_t k) const {
+        const auto& b = blocks[k / lanes];
+        auto l = int(k % lanes);
+        return ray(b.origin.get(l), b.direction.get(l), b.time[l], b.spread[l], b.width[l]);
+    }
+
+    void gather(const ray_queue& src, const std::vector<int>& order) { // 按 order 的顺序从 src 取出射线（重排队列）
+        clear();
+        for (int k : order) push(src.get(k), src.path[k]);
+    }
+
+private:
+    static void set(block& b, int l, const ray& r) {
+        b.origin.set(l, r.origin());
+        b.direction.set(l, r.direction());
+        b.time[l] = r.time();
+        b.spread[l] = r.spread();
+        b.width[l] = r.width();
+    }
+};
+
+class ray_sorter {
+    // 射线重排：按 方向卦限(3位) | 起点的 Morton 码(每轴9位) 组成的30位键做基数排序，
+    // 起点相近、方向大致相同的射线排在一起，求交时连续的射线访问相同的BVH结点和图元。
+    // 起点在队列中所有起点的包围盒内量化（不用场景包围盒，场景里有很大的物体时量化会太粗）。
+    // 包围盒和排序键都按队列的块逐路计算（块的空位是真实射线的副本，不影响包围盒，算出的键不参与排序）
+public:
+    void sort(const ray_queue& q, std::vector<int>& order) { // 写入排序后的队列下标
+        const int lanes = ray_queue::lanes;
+        auto n = q.size();
+        keys.resize(q.blocks.size() * lanes);
+        order.resize(n);
+
+        double lo[3] = {infinity, infinity, infinity}, hi[3] = {-infinity, -infinity, -infinity}, scale[3];
+        wide_vec3<lanes> lane_lo, lane_hi; // 逐路的最小、最大值，最后再合并各路
+        for (int a = 0; a < 3; a++)
+            for (int l = 0; l < lanes; l++) {
+                lane_lo[a][l] = infinity;
+                lane_hi[a][l] = -infinity;
+            }
+        for (const auto& b : q.blocks)
+            for (int a = 0; a < 3; a++)
+                for (int l = 0; l < lanes; l++) {
+                    lane_lo[a][l] = std::min(lane_lo[a][l], b.origin[a][l]);
+                    lane_hi[a][l] = std::max(lane_hi[a][l], b.origin[a][l]);
+                }
+        for (int a = 0; a < 3; a++)
+            for (int l = 0; l < lanes; l++) {
+                lo[a] = std::min(lo[a], lane_lo[a][l]);
+                hi[a] = std::max(hi[a], lane_hi[a][l]);
+            }
+        for (int a = 0; a < 3; a++)
+            scale[a] = hi[a] > lo[a] ? 511.999 / (hi[a] - lo[a]) : 0;
+
+        for (size_t i = 0; i < q.blocks.size(); i++) {
+            const auto& b = q.blocks[i];
+            auto key = keys.data() + i * lanes;
+            for (int l = 0; l < lanes; l++) {
+                // 三个轴分开写（不用按轴下标的小数组），卦限位也先在 double 里算出，再经过 int 转换（double 比较得到的64位掩码直接转成32位整数，以及 double 到 uint32 的转换，编译器都不会向量化）
+                auto x = uint32_t(int(std::min(std::max((b.origin[0][l] - lo[0]) * scale[0], 0.0), 511.0)));
+                auto y = uint32_t(int(std::min(std::max((b.origin[1][l] - lo[1]) * scale[1], 0.0), 511.0)));
+                auto z = uint32_t(int(std::min(std::max((b.origin[2][l] - lo[2]) * scale[2], 0.0), 511.0)));
+                auto octant = uint32_t(int((b.direction[0][l] < 0 ? 1.0 : 0.0) + (b.direction[1][l] < 0 ? 2.0 : 0.0) + (b.direction[2][l] < 0 ? 4.0 : 0.0)));
+                key[l] = octant << 27 | spread_bits(x) << 2 | spread_bits(y) << 1 | spread_bits(z);
+            }
+        }
+        for (size_t k = 0; k < n; k++) order[k] = int(k);
+
+        radix_sort(order);
+    }
+
+private:
+    std::vector<uint32_t> keys;         // 每条射线的排序键
+    std::vector<int> scratch;           // 基数排序的临时数组
+
+    static uint32_t spread_bits(uint32_t v) { // 把9位整数的各位分开放到每隔两位的位置上（Morton 码的一个分量）
+        v &= 0x1ff;
+        v = (v | (v << 16)) & 0x030000ff;
+        v = (v | (v << 8))  & 0x0300f00f;
+        v = (v | (v << 4))  & 0x030c30c3;
+        v = (v | (v << 2))  & 0x09249249;
+        return v;
+    }
+
+    void radix_sort(std::vector<int>& order) { // 按键的低位到高位，每次8位做稳定的计数排序；所有键在某8位上相同时跳过这一趟
+        scratch.resize(order.size());
+        for (int shift = 0; shift < 30; shift += 8) {
+            size_t count[257] = {};
+            for (int k : order) count[((keys[k] >> shift) & 0xff) + 1]++;
+            if (*std::max_element(count + 1, count + 257) == order.size()) continue;
+
+            for (int b = 0; b < 256; b++) count[b + 1] += count[b];
+            for (int k : order) scratch[count[(keys[k] >> shift) & 0xff]++] = k;
+            order.swap(scratch);
+        }
+    }
+};
+
+class path_states { // 波前积分器中各条路径的状态（按路径下标，各分量分开存储）
+public:
+    std::vector<size_t> sample_id;      // 路径对应的样本（像素序号 * 每像素样本数 + 样本序号）
+    std::vector<sampler> samples;       // 采样器状态
+    std::vector<color> throughput;      // 路径吞吐量
+    std::vector<color> radiance;        // 已累积的辐射亮度
+    std::vector<double> bsdf_pdf;       // 上一个交点BSDF采样到当前方向的概率密度
+    std::vector<medium_stack> media;    // 当前射线起点所在的介质
+    std::vector<aov_sample> aovs;       // 辅助输出
+
+    void resize(size_t n) {
+        sample_id.resize(n);
+        samples.resize(n);
+        throughput.resize(n);
+        radiance.resize(n);
+        bsdf_pdf.resize(n);
+        media.resize(n);
+        aovs.resize(n);
+    }
+
+    void compact(const std::vector<int>& paths) { // 只保留 paths 中的路径，按其顺序重新编号为 0,1,2...（状态随射线重排后连续访问）
+        gather(sample_id, paths);
+        gather(samples, paths);
+        gather(throughput, paths);
+        gather(radiance, paths);
+        gather(bsdf_pdf, paths);
+        gather(media, paths);
+        gather(aovs, paths);
+    }
+
+private:
+    template <typename T>
+    static void gather(std::vector<T>& v, const std::vector<int>& index) { // 交换后旧数组留作下一次的缓冲，不必每次重新分配
+        thread_local std::vector<T> out;
+        out.resize(index.size());
+        for (size_t k = 0; k < index.size(); k++) out[k] = v[index[k]];
+        v.swap(out);
+    }
+};
+
+class shadow_queue : public ray_queue { // 阴影射线队列：另存起点所在的介质和未被遮挡时的贡献系数（命中的发光值还要再乘上）
+public:
+    std::vector<medium_stack> media;    // 射线起点所在的介质
+    std::vector<color> factor;          // 吞吐量 * BSDF * MIS权重 / 光源概率密度
+
+    void clear() {
+        ray_queue::clear();
+        media.clear();
+        factor.clear();
+    }
+
+    void push(const ray& r, int path_index, const medium_stack& m, const color& f) {
+        ray_queue::push(r, path_index);
+        media.push_back(m);
+        factor.push_back(f);
+    }
+};
+
+class wavefront_stats { // 波前积分器的统计：各阶段的累计耗时，以及每次反弹的队列长度之和
+public:
+    enum stage { generate, reorder, intersect, sort, shade, shadow, accumulate, stage_count };
+
+    static const char* stage_name(stage s) {
+        static const char* names[stage_count] = {"generate", "reorder", "intersect", "sort", "shade", "shadow", "accumulate"};
+        return names[s];
+    }
+
+    class timer { // 作用域计时：析构时把经过的时间加到对应阶段（打开 RTW_TRACE 时同时记入时间线）
+    public:
+        timer(wavefront_stats& stats, stage s) : stats(stats), s(s), start(std::chrono::steady_clock::now()) {}
+        ~timer() { stats.seconds[s] += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(); }
+
+    private:
+        wavefront_stats& stats;
+        stage s;
+        std::chrono::steady_clock::time_point start;
+#if RTW_TRACE
+        trace_zone zone{"wavefront", stage_name(s)};
+#endif
+    };
+
+    void count_rays(int depth, size_t rays, size_t shadow_rays) { // 记录第depth次反弹的射线数和阴影射线数
+        if (depth >= int(rays_per_depth.size())) {
+            rays_per_depth.resize(depth + 1, 0);
+            shadow_per_depth.resize(depth + 1, 0);
+        }
+        rays_per_depth[depth] += rays;
+        shadow_per_depth[depth] += shadow_rays;
+    }
+
+    void report(std::ostream& out) const {
+        double total = 0;
+        for (auto s : seconds) total += s;
+
+        size_t rays = 0, shadow_rays = 0;
+        for (auto n : rays_per_depth) rays += n;
+        for (auto n : shadow_per_depth) shadow_rays += n;
+
+        out << "Wavefront: " << waves << " waves, " << rays << " rays, " << shadow_rays << " shadow rays, "
+            << total << " s (" << (total > 0 ? (rays + shadow_rays) / total * 1e-6 : 0.0) << " Mrays/s)\n";
+        for (int s = 0; s < stage_count; s++)
+            out << "  " << stage_name(stage(s)) << ": " << seconds[s] << " s (" << (total > 0 ? 100 * seconds[s] / total : 0.0) << "%)\n";
+        out << "  rays per bounce:";
+        for (auto n : rays_per_depth) out << ' ' << n;
+        out << "\n  shadow rays per bounce:";
+        for (auto n : shadow_per_depth) out << ' ' << n;
+        out << '\n';
+    }
+
+    int waves = 0; // 批次数
+
+private:
+    double seconds[stage_count] = {};       // 各阶段累计耗时
+    std::vector<size_t> rays_per_depth;     // 每次反弹的射线数（所有批次之和）
+    std::vector<size_t> shadow_per_depth;   // 每次反弹的阴影射线数
+};
\ No newline at end of file
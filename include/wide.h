@@ -0,0 +1,37 @@
+#pragma once
+
+#include "vec3.h"
+
+#include <cstdint>
+
+template <int N>
+class wide { // N 路 double（按分量存储的数据的一个分量），按64字节对齐。
+    // 运算直接写成对各路的定长循环（整个表达式放在一个循环体里），编译器按开启的指令集向量化：SSE2 每条指令2路，AVX 4路，AVX-512 8路。
+    // 不提供逐个运算的重载：每个运算各自一个循环时中间结果都要写回内存，比标量代码还慢
+public:
+    alignas(64) double lane[N];
+
+    double operator[](int k) const { return lane[k]; }
+    double& operator[](int k) { return lane[k]; }
+
+    friend uint32_t less_mask(const wide& a, const wide& b) { // a<b 的路（按位）
+        uint32_t m = 0;
+        for (int k = 0; k < N; k++) m |= uint32_t(a.lane[k] < b.lane[k]) << k;
+        return m;
+    }
+};
+
+template <int N>
+class wide_vec3 { // N 个 vec3，x、y、z 分量各自连续存储
+public:
+    wide<N> e[3];
+
+    const wide<N>& operator[](int a) const { return e[a]; }
+    wide<N>& operator[](int a) { return e[a]; }
+
+    void set(int k, const vec3& v) { // 写入第k路
+        for (int a = 0; a < 3; a++) e[a][k] = v[a];
+    }
+
+    vec3 get(int k) const { return vec3(e[0][k], e[1][k], e[2][k]); }
+};
\ No newline at end of file